@@ -15,6 +15,7 @@ void HIDAbsMouse::click(uint8_t b)
     report.wheel = 0;
 	report.buttons = b;
     sendReport();
+    flushReport();
 	report.buttons = 0;
     sendReport();
 }
@@ -0,0 +1,341 @@
+#ifndef _HIDREPORTBUILDER_H_
+#define _HIDREPORTBUILDER_H_
+
+#include <stdint.h>
+#include <USBHID.h>
+
+/*
+ * Compile-time HID report descriptors. A report is described once, as a list
+ * of fields, and the same definition gives both the descriptor bytes and the
+ * bit layout used by HIDTypedReport to fill in the report, so the two cannot
+ * disagree. Offsets and widths are template constants; set() and get() with
+ * constant arguments come down to a few shifts and masks.
+ *
+ *   typedef HIDBuilder::Report<HID_JOYSTICK_REPORT_ID,
+ *       HIDBuilder::Buttons<16>,
+ *       HIDBuilder::Field<0x01, 8, 2, -127, 127, 0x30, 0x31>  // X, Y
+ *   > PadReport;
+ *   typedef HIDBuilder::Descriptor<HIDBuilder::Application<0x01, 0x05, PadReport> > PadDescriptor;
+ *
+ *   HIDTypedReport<PadReport> pad;
+ *   USBHID.begin(PadDescriptor::data, PadDescriptor::size);
+ *   pad.set<1>(0, x); pad.send();
+ *
+ * Only input fields are generated; reports have to add up to whole bytes
+ * (use Padding<>).
+ */
+
+namespace HIDBuilder {
+
+template<uint8_t... b> struct Bytes {
+    static constexpr unsigned size = sizeof...(b);
+    static constexpr uint8_t data[sizeof...(b) ? sizeof...(b) : 1] = { b... };
+};
+template<uint8_t... b> constexpr uint8_t Bytes<b...>::data[];
+
+template<typename... T> struct Concat;
+template<> struct Concat<> {
+    typedef Bytes<> type;
+};
+template<uint8_t... a> struct Concat<Bytes<a...> > {
+    typedef Bytes<a...> type;
+};
+template<uint8_t... a, uint8_t... b, typename... Rest> struct Concat<Bytes<a...>, Bytes<b...>, Rest...> {
+    typedef typename Concat<Bytes<a..., b...>, Rest...>::type type;
+};
+
+template<bool c, typename A, typename B> struct If {
+    typedef A type;
+};
+template<typename A, typename B> struct If<false, A, B> {
+    typedef B type;
+};
+
+template<unsigned... v> struct Sum;
+template<> struct Sum<> {
+    static const unsigned value = 0;
+};
+template<unsigned a, unsigned... rest> struct Sum<a, rest...> {
+    static const unsigned value = a + Sum<rest...>::value;
+};
+
+// Short items with the smallest data size that holds the value. Tags have the size bits clear.
+template<uint8_t tag, uint32_t v, int size = (v <= 0xFF ? 1 : v <= 0xFFFF ? 2 : 4)> struct UnsignedItem {
+    typedef Bytes<tag|3, uint8_t(v), uint8_t(v>>8), uint8_t(v>>16), uint8_t(v>>24)> type;
+};
+template<uint8_t tag, uint32_t v> struct UnsignedItem<tag, v, 1> {
+    typedef Bytes<tag|1, uint8_t(v)> type;
+};
+template<uint8_t tag, uint32_t v> struct UnsignedItem<tag, v, 2> {
+    typedef Bytes<tag|2, uint8_t(v), uint8_t(v>>8)> type;
+};
+
+// Logical minimum and maximum are signed, so 255 takes two bytes (a one byte 0xFF is -1).
+template<uint8_t tag, int32_t v, int size = (v >= -128 && v <= 127 ? 1 : v >= -32768 && v <= 32767 ? 2 : 4)> struct SignedItem {
+    typedef Bytes<tag|3, uint8_t(v), uint8_t(v>>8), uint8_t(v>>16), uint8_t(v>>24)> type;
+};
+template<uint8_t tag, int32_t v> struct SignedItem<tag, v, 1> {
+    typedef Bytes<tag|1, uint8_t(v)> type;
+};
+template<uint8_t tag, int32_t v> struct SignedItem<tag, v, 2> {
+    typedef Bytes<tag|2, uint8_t(v), uint8_t(v>>8)> type;
+};
+
+#define HID_ITEM_USAGE_PAGE    0x04
+#define HID_ITEM_USAGE         0x08
+#define HID_ITEM_USAGE_MINIMUM 0x18
+#define HID_ITEM_USAGE_MAXIMUM 0x28
+#define HID_ITEM_LOGICAL_MIN   0x14
+#define HID_ITEM_LOGICAL_MAX   0x24
+#define HID_ITEM_REPORT_SIZE   0x74
+#define HID_ITEM_REPORT_ID     0x84
+#define HID_ITEM_REPORT_COUNT  0x94
+
+/* count values of bits bits each, from min to max, with the usages in order
+ * (the last one applies to the rest). */
+template<uint16_t page, uint8_t bits, uint8_t count, int32_t min, int32_t max, uint16_t... usages> struct Field {
+    static_assert(bits >= 1 && bits <= 32, "a field is 1 to 32 bits wide");
+    static_assert(count >= 1, "a field has at least one value");
+    static_assert(min <= max, "logical minimum is over the maximum");
+    static_assert(bits == 32 || (min < 0 ?
+            (int64_t)min >= -((int64_t)1 << (bits-1)) && (int64_t)max < ((int64_t)1 << (bits-1)) :
+            (int64_t)max < ((int64_t)1 << bits)), "logical range does not fit in the field");
+    static const unsigned elementBits = bits;
+    static const unsigned elements = count;
+    static const unsigned totalBits = bits * count;
+    static const bool isSigned = min < 0;
+    typedef typename Concat<
+        typename UnsignedItem<HID_ITEM_USAGE_PAGE, page>::type,
+        typename UnsignedItem<HID_ITEM_USAGE, usages>::type...,
+        typename SignedItem<HID_ITEM_LOGICAL_MIN, min>::type,
+        typename SignedItem<HID_ITEM_LOGICAL_MAX, max>::type,
+        typename UnsignedItem<HID_ITEM_REPORT_SIZE, bits>::type,
+        typename UnsignedItem<HID_ITEM_REPORT_COUNT, count>::type,
+        Bytes<0x81, 0x02> // Input (Data, Variable, Absolute)
+    >::type descriptor;
+};
+
+// count one bit buttons, numbered from first
+template<uint8_t count, uint8_t first=1> struct Buttons {
+    static const unsigned elementBits = 1;
+    static const unsigned elements = count;
+    static const unsigned totalBits = count;
+    static const bool isSigned = false;
+    typedef typename Concat<
+        typename UnsignedItem<HID_ITEM_USAGE_PAGE, 0x09>::type,
+        typename UnsignedItem<HID_ITEM_USAGE_MINIMUM, first>::type,
+        typename UnsignedItem<HID_ITEM_USAGE_MAXIMUM, first+count-1>::type,
+        typename SignedItem<HID_ITEM_LOGICAL_MIN, 0>::type,
+        typename SignedItem<HID_ITEM_LOGICAL_MAX, 1>::type,
+        typename UnsignedItem<HID_ITEM_REPORT_SIZE, 1>::type,
+        typename UnsignedItem<HID_ITEM_REPORT_COUNT, count>::type,
+        Bytes<0x81, 0x02>
+    >::type descriptor;
+};
+
+template<uint8_t bits> struct Padding {
+    static const unsigned elementBits = bits;
+    static const unsigned elements = 1;
+    static const unsigned totalBits = bits;
+    static const bool isSigned = false;
+    typedef typename Concat<
+        typename UnsignedItem<HID_ITEM_REPORT_SIZE, bits>::type,
+        typename UnsignedItem<HID_ITEM_REPORT_COUNT, 1>::type,
+        Bytes<0x81, 0x03> // Input (Constant, Variable, Absolute)
+    >::type descriptor;
+};
+
+/* count hat switches, 4 bits each: 0 to 7 for north, north-east and so on,
+ * anything else (15) when centered */
+template<uint8_t count> struct Hats {
+    static const unsigned elementBits = 4;
+    static const unsigned elements = count;
+    static const unsigned totalBits = 4 * count;
+    static const bool isSigned = false;
+    typedef typename Concat<
+        typename UnsignedItem<HID_ITEM_USAGE_PAGE, 0x01>::type,
+        typename UnsignedItem<HID_ITEM_USAGE, 0x39>::type,
+        typename SignedItem<HID_ITEM_LOGICAL_MIN, 0>::type,
+        typename SignedItem<HID_ITEM_LOGICAL_MAX, 7>::type,
+        Bytes<0x35, 0x00, 0x46, 0x3B, 0x01, 0x65, 0x14>, // Physical 0 to 315, Unit (degrees)
+        typename UnsignedItem<HID_ITEM_REPORT_SIZE, 4>::type,
+        typename UnsignedItem<HID_ITEM_REPORT_COUNT, count>::type,
+        Bytes<0x81, 0x42>, // Input (Data, Variable, Absolute, Null State)
+        Bytes<0x45, 0x00, 0x65, 0x00> // Physical Maximum and Unit back to none
+    >::type descriptor;
+};
+
+// A field of no bits, for leaving one out of a report
+struct Nothing {
+    static const unsigned elementBits = 0;
+    static const unsigned elements = 0;
+    static const unsigned totalBits = 0;
+    static const bool isSigned = false;
+    typedef Bytes<> descriptor;
+};
+
+// Padding up to the next byte after bits bits
+template<unsigned bits> struct PadToByte : If<bits % 8 != 0, Padding<8 - bits % 8>, Nothing>::type {};
+
+template<unsigned n, typename... F> struct FieldAt;
+template<typename F, typename... Rest> struct FieldAt<0, F, Rest...> {
+    typedef F type;
+    static const unsigned offset = 0;
+};
+template<unsigned n, typename F, typename... Rest> struct FieldAt<n, F, Rest...> {
+    typedef typename FieldAt<n-1, Rest...>::type type;
+    static const unsigned offset = F::totalBits + FieldAt<n-1, Rest...>::offset;
+};
+
+// reportID 0 means the device has no report IDs
+template<uint8_t id, typename... Fields> struct Report {
+    static const uint8_t reportID = id;
+    static const unsigned fields = sizeof...(Fields);
+    static const unsigned bits = Sum<Fields::totalBits...>::value;
+    static_assert(bits % 8 == 0, "report is not a whole number of bytes, add Padding<>");
+    static const unsigned size = bits / 8; // without the report ID
+    template<unsigned index> struct At : FieldAt<index, Fields...> {};
+    typedef typename Concat<
+        typename If<id != 0, typename UnsignedItem<HID_ITEM_REPORT_ID, id>::type, Bytes<> >::type,
+        typename Fields::descriptor...
+    >::type descriptor;
+};
+
+template<uint16_t page, uint16_t usage, typename... Reports> struct Application {
+    typedef typename Concat<
+        typename UnsignedItem<HID_ITEM_USAGE_PAGE, page>::type,
+        typename UnsignedItem<HID_ITEM_USAGE, usage>::type,
+        Bytes<0xA1, 0x01>, // Collection (Application)
+        typename Reports::descriptor...,
+        Bytes<0xC0>
+    >::type descriptor;
+};
+
+// Several applications one after the other; data and size go to setReportDescriptor()
+template<typename... Applications> struct Descriptor : Concat<typename Applications::descriptor...>::type {};
+
+// The report of HIDGamepad: buttons, hats and axes, each padded to a byte
+template<unsigned axes, unsigned bits, unsigned buttons, unsigned hats, uint8_t id> struct GamepadLayout {
+    typedef Report<id,
+        typename If<buttons != 0, Buttons<buttons>, Nothing>::type,
+        PadToByte<buttons>,
+        typename If<hats != 0, Hats<hats>, Nothing>::type,
+        PadToByte<4 * hats>,
+        typename If<axes != 0, Field<0x01, bits, axes, 0, (1ul << bits) - 1,
+            0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37, 0x36>, Nothing>::type,
+        PadToByte<axes * bits>
+    > type;
+};
+
+// Little-endian bit field access, as HID packs report fields
+static inline void setBits(uint8_t* p, unsigned offset, unsigned bits, uint32_t value) {
+    for (unsigned i = 0; i < bits; ) {
+        unsigned shift = (offset + i) % 8;
+        unsigned n = 8 - shift < bits - i ? 8 - shift : bits - i;
+        uint8_t mask = ((1u << n) - 1) << shift;
+        uint8_t* b = p + (offset + i) / 8;
+        *b = (*b & ~mask) | ((value >> i << shift) & mask);
+        i += n;
+    }
+}
+
+static inline uint32_t getBits(const uint8_t* p, unsigned offset, unsigned bits) {
+    uint32_t value = 0;
+    for (unsigned i = 0; i < bits; ) {
+        unsigned shift = (offset + i) % 8;
+        unsigned n = 8 - shift < bits - i ? 8 - shift : bits - i;
+        value |= (uint32_t)((p[(offset + i) / 8] >> shift) & ((1u << n) - 1)) << i;
+        i += n;
+    }
+    return value;
+}
+
+}
+
+/* A report laid out by a HIDBuilder::Report. set<n>() and get<n>() work on
+ * field n (counting from 0), element being the value within the field. */
+template<typename R> class HIDTypedReport : public HIDReporter {
+protected:
+    uint8_t report[1 + R::size];
+public:
+    HIDTypedReport() : HIDReporter(report, sizeof(report), R::reportID) {}
+    template<unsigned index> void set(unsigned element, int32_t value) {
+        typedef typename R::template At<index> F;
+        HIDBuilder::setBits(report + 1, F::offset + element * F::type::elementBits, F::type::elementBits, (uint32_t)value);
+    }
+    template<unsigned index> void set(int32_t value) {
+        set<index>(0, value);
+    }
+    template<unsigned index> int32_t get(unsigned element=0) {
+        typedef typename R::template At<index> F;
+        const unsigned bits = F::type::elementBits;
+        uint32_t value = HIDBuilder::getBits(report + 1, F::offset + element * bits, bits);
+        if (F::type::isSigned && bits < 32 && (value & (1ul << (bits - 1))))
+            value |= ~0ul << (bits & 31);
+        return (int32_t)value;
+    }
+    inline void send() {
+        sendReport();
+    }
+};
+
+/* A joystick with axes unsigned axes of bits bits each (X, Y, Z, Rx, Ry, Rz,
+ * Slider, Dial, then more sliders), buttons buttons and hats hat switches. The
+ * descriptor is HIDGamepad<...>::Descriptor::data and ::size. The setters only
+ * change the report; send() sends it, so a whole update is one report. */
+template<unsigned axes, unsigned bits=16, unsigned buttons=32, unsigned hats=1, uint8_t id=HID_JOYSTICK_REPORT_ID>
+class HIDGamepad : public HIDTypedReport<typename HIDBuilder::GamepadLayout<axes, bits, buttons, hats, id>::type> {
+    static_assert(bits >= 1 && bits <= 16, "gamepad axes are 1 to 16 bits");
+    static_assert(buttons <= 255 && hats <= 255 && axes <= 255, "too many controls");
+    enum { BUTTONS = 0, HATS = 2, AXES = 4 };
+public:
+    typedef typename HIDBuilder::GamepadLayout<axes, bits, buttons, hats, id>::type ReportType;
+    static_assert(1 + ReportType::size <= USB_HID_TX_EPSIZE, "gamepad report does not fit in a packet");
+    typedef HIDBuilder::Descriptor<HIDBuilder::Application<0x01, 0x05, ReportType> > Descriptor;
+    static const uint16_t axisMax = (1ul << bits) - 1;
+
+    HIDGamepad() {
+        for (unsigned i = 0; i < hats; i++)
+            this->template set<HATS>(i, 15);
+        for (unsigned i = 0; i < axes; i++)
+            this->template set<AXES>(i, axisMax / 2 + 1);
+    }
+    void begin(void) {}
+    void end(void) {}
+    // Values over axisMax are clamped
+    void axis(unsigned n, uint16_t value) {
+        if (n < axes)
+            this->template set<AXES>(n, value > axisMax ? axisMax : value);
+    }
+    // Sets axes 0 to count-1
+    void setAxes(const uint16_t* values, unsigned count=axes) {
+        for (unsigned i = 0; i < count && i < axes; i++)
+            axis(i, values[i]);
+    }
+    // Buttons are numbered from 1, as for HIDJoystick
+    void button(unsigned n, bool value) {
+        if (n >= 1 && n <= buttons)
+            HIDBuilder::setBits(this->report + 1, n - 1, 1, value);
+    }
+    // Sets up to 32 buttons from first on, bit 0 of mask being button first
+    void setButtons(uint32_t mask, unsigned first=1) {
+        if (first < 1 || first > buttons)
+            return;
+        unsigned n = buttons - first + 1;
+        HIDBuilder::setBits(this->report + 1, first - 1, n < 32 ? n : 32, mask);
+    }
+    // Sets all the buttons from a bitmap of (buttons+7)/8 bytes, button 1 in bit 0 of the first
+    void setButtons(const uint8_t* bitmap) {
+        memcpy(this->report + 1, bitmap, (buttons + 7) / 8);
+    }
+    bool isPressed(unsigned n) {
+        return n >= 1 && n <= buttons && HIDBuilder::getBits(this->report + 1, n - 1, 1);
+    }
+    // dir in degrees, or -1 for centered (as HIDJoystick::hat())
+    void hat(unsigned n, int16_t dir) {
+        if (n < hats)
+            this->template set<HATS>(n, dir < 0 || dir >= 360 ? 15 : (dir + 22) / 45 % 8);
+    }
+};
+
+#endif
@@ -12,3 +12,6 @@ REPORT(Mouse, HID_MOUSE_REPORT_DESCRIPTOR());
 REPORT(KeyboardJoystick, HID_KEYBOARD_REPORT_DESCRIPTOR(), HID_JOYSTICK_REPORT_DESCRIPTOR());
 REPORT(Joystick, HID_JOYSTICK_REPORT_DESCRIPTOR());
 REPORT(BootKeyboard, HID_BOOT_KEYBOARD_REPORT_DESCRIPTOR());
+REPORT(NKROKeyboard, HID_NKRO_KEYBOARD_REPORT_DESCRIPTOR());
+REPORT(Mouse16, HID_MOUSE16_REPORT_DESCRIPTOR());
+REPORT(Digitizer, HID_DIGITIZER_REPORT_DESCRIPTOR(HID_DIGITIZER_CONTACTS));
@@ -0,0 +1,127 @@
+#include "USBHID.h"
+#include <wirish.h>
+
+//================================================================================
+//================================================================================
+//	Sequencer
+
+void HIDSequencer::start(const HIDAction* actions, void (*done)(void)) {
+    next = NULL;
+    doneCallback = done;
+    wakeAt = millis();
+    tapping = false;
+    next = actions;
+}
+
+void HIDSequencer::stop(void) {
+    const HIDAction* action = next;
+    next = NULL;
+    if (tapping && action != NULL && keyboard != NULL)
+        keyboard->release(action->key); // stopped between the two halves of a tap
+    tapping = false;
+}
+
+HIDReporter* HIDSequencer::reporterFor(uint8_t type) {
+    switch (type) {
+    case HID_ACTION_KEY_DOWN:
+    case HID_ACTION_KEY_UP:
+    case HID_ACTION_KEY_TAP:
+        return keyboard;
+    case HID_ACTION_CONSUMER_PRESS:
+    case HID_ACTION_CONSUMER_RELEASE:
+        return consumer;
+    case HID_ACTION_MOUSE_MOVE:
+    case HID_ACTION_MOUSE_PRESS:
+    case HID_ACTION_MOUSE_RELEASE:
+    case HID_ACTION_MOUSE_SCROLL:
+        return mouse;
+    default:
+        return NULL;
+    }
+}
+
+/* Whether an action for reporter has to wait for earlier reports to go out.
+ * Sending now could replace a report still waiting in a coalescing queue, or
+ * block on a full one, which the USB interrupt cannot empty while a timer
+ * interrupt runs tick(). */
+bool HIDSequencer::busy(HIDReporter* reporter) {
+    uint8_t instance = reporter->getHIDInstance();
+    if (usb_hid_get_pending(instance) != 0 || usb_hid_report_pending(instance, reporter->getReportID()) != 0)
+        return true;
+    // an accumulating mouse waits for its motion to go out before a button change
+    return reporter == mouse && mouse->isMoving();
+}
+
+void HIDSequencer::tick(void) {
+    if (ticking)
+        return; // tick() from loop() interrupted by tick() from a timer
+    ticking = true;
+
+    const HIDAction* action;
+    while (NULL != (action = next) && (int32_t)(millis() - wakeAt) >= 0) {
+        HIDReporter* reporter = reporterFor(action->type);
+        if (reporter != NULL && busy(reporter))
+            break; // try again at the next tick
+        next = action + 1;
+
+        switch (action->type) {
+        case HID_ACTION_END:
+            next = NULL;
+            if (doneCallback != NULL)
+                doneCallback();
+            break;
+        case HID_ACTION_WAIT:
+            wakeAt = millis() + action->value;
+            break;
+        case HID_ACTION_KEY_DOWN:
+            if (keyboard != NULL)
+                keyboard->press(action->key);
+            break;
+        case HID_ACTION_KEY_UP:
+            if (keyboard != NULL)
+                keyboard->release(action->key);
+            break;
+        case HID_ACTION_KEY_TAP:
+            // write() would wait for the press to go out, which the USB interrupt
+            // cannot do while a timer interrupt is running tick()
+            if (keyboard == NULL)
+                break;
+            if (!tapping) {
+                keyboard->press(action->key);
+                tapping = true;
+                next = action; // released once the press has gone out
+            }
+            else {
+                keyboard->release(action->key);
+                tapping = false;
+            }
+            break;
+        case HID_ACTION_CONSUMER_PRESS:
+            if (consumer != NULL)
+                consumer->press(action->value);
+            break;
+        case HID_ACTION_CONSUMER_RELEASE:
+            if (consumer != NULL)
+                consumer->release();
+            break;
+        case HID_ACTION_MOUSE_MOVE:
+            if (mouse != NULL)
+                mouse->move((int8_t)(action->value & 0xFF), (int8_t)(action->value >> 8));
+            break;
+        case HID_ACTION_MOUSE_PRESS:
+            if (mouse != NULL)
+                mouse->press(action->key);
+            break;
+        case HID_ACTION_MOUSE_RELEASE:
+            if (mouse != NULL)
+                mouse->release(action->key);
+            break;
+        case HID_ACTION_MOUSE_SCROLL:
+            if (mouse != NULL)
+                mouse->move(0, 0, (int8_t)action->value);
+            break;
+        }
+    }
+
+    ticking = false;
+}
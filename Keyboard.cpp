@@ -146,6 +146,28 @@ void HIDKeyboard::begin(void){
 void HIDKeyboard::end(void) {
 }
 
+void HIDKeyboard::ledsWritten(void* keyboard, const uint8* data, uint16 length)
+{
+    HIDKeyboard* k = (HIDKeyboard*)keyboard;
+    if (length == 0)
+        return;
+    uint8_t leds = data[0]; // the report that came in, whether through the boot or the report protocol buffer
+    if (leds != k->lastLEDs && k->ledCallback != NULL) {
+        k->lastLEDs = leds;
+        k->ledCallback(leds);
+    }
+}
+
+bool HIDKeyboard::setLEDCallback(void (*callback)(uint8_t leds), bool deferred)
+{
+    ledCallback = callback;
+    lastLEDs = getLEDs();
+    HIDBufferCallback written = callback != NULL ? ledsWritten : NULL;
+    if (reportID != 0) // a boot keyboard's LED report, if it has one
+        usb_hid_set_buffer_callback(getHIDInstance(), HID_REPORT_TYPE_OUTPUT, 0, written, this, deferred);
+    return usb_hid_set_buffer_callback(getHIDInstance(), HID_REPORT_TYPE_OUTPUT, reportID, written, this, deferred);
+}
+
 // 136: non-printing key
 // shift -> 0x02
 // modifiers: 128 --> bit shift
@@ -205,7 +227,7 @@ size_t HIDKeyboard::press(uint8_t k) {
 
 SEND:
     keyReport.modifiers |= modifiers;
-    sendReport();
+    sendKeyReport();
     return 1;
 }
 
@@ -232,7 +254,7 @@ size_t HIDKeyboard::release(uint8_t k)
     
     keyReport.modifiers &= ~modifiers;
     
-	sendReport();
+	sendKeyReport();
 	return 1;
 }
 
@@ -241,12 +263,149 @@ void HIDKeyboard::releaseAll(void)
     memset(keyReport.keys, 0, HID_KEYBOARD_ROLLOVER);
 	keyReport.modifiers = 0;
 	
-	sendReport();
+	sendKeyReport();
+}
+
+/* Runs in the USB interrupt whenever the last report has gone out. The keys at
+ * the front of the queue go into one report for as long as they share the same
+ * modifiers and none of them is already down; a key that is already down, or a
+ * change of modifiers, has to wait for a report that releases everything. */
+void HIDKeyboard::typeNext(void)
+{
+    uint8_t keys[HID_KEYBOARD_ROLLOVER];
+    unsigned n = 0;
+    uint8_t modifiers = 0;
+    bool started = false;
+    bool down = typingReport.modifiers != 0;
+    uint8_t tail = typingTail;
+
+    for (unsigned i = 0; i<HID_KEYBOARD_ROLLOVER; i++)
+        down = down || typingReport.keys[i] != 0;
+
+    while (tail != typingHead && n < HID_KEYBOARD_ROLLOVER) {
+        uint8_t keyModifiers;
+        uint8_t k = getKeyCode(typingQueue[tail], &keyModifiers);
+        if (k == 0 && keyModifiers == 0) {
+            tail = (tail + 1) % HID_KEYBOARD_TYPING_QUEUE_SIZE;
+            continue;
+        }
+        if (started ? keyModifiers != modifiers : down && keyModifiers != typingReport.modifiers)
+            break;
+        if (k != 0 && (memchr(keys, k, n) != NULL || memchr(typingReport.keys, k, HID_KEYBOARD_ROLLOVER) != NULL))
+            break;
+        started = true;
+        modifiers = keyModifiers;
+        tail = (tail + 1) % HID_KEYBOARD_TYPING_QUEUE_SIZE;
+        if (k == 0)
+            break; // a modifier on its own gets a report of its own
+        keys[n++] = k;
+    }
+    typingTail = tail;
+
+    if (!started) {
+        if (!down)
+            return;
+        n = 0;
+        modifiers = 0;
+    }
+    typingReport.reportID = reportID;
+    typingReport.modifiers = modifiers;
+    memset(typingReport.keys, 0, HID_KEYBOARD_ROLLOVER);
+    memcpy(typingReport.keys, keys, n);
+    sendTypingReport();
+}
+
+// The typed keys go in the free places of report, which has the keys held with press()
+void HIDKeyboard::addTypedKeys(KeyReport_t* report)
+{
+    report->modifiers |= typingReport.modifiers;
+    for (unsigned i = 0; i<HID_KEYBOARD_ROLLOVER; i++) {
+        uint8_t k = typingReport.keys[i];
+        if (k == 0 || memchr(report->keys, k, HID_KEYBOARD_ROLLOVER) != NULL)
+            continue;
+        uint8_t* free = (uint8_t*)memchr(report->keys, 0, HID_KEYBOARD_ROLLOVER);
+        if (free == NULL)
+            break;
+        *free = k;
+    }
+}
+
+/* Typing reports share the report ID of keyReport, so each one carries the
+ * keys held with press() as well, or the host would see them released; the
+ * one that ends the typing leaves just those down. */
+bool HIDKeyboard::sendTypingReport(void)
+{
+    KeyReport_t report = keyReport;
+    report.reportID = reportID;
+    addTypedKeys(&report);
+    unsigned skip = reportID == 0;
+    return usb_hid_tx_report(getHIDInstance(), reportID, (uint8_t*)&report + skip, sizeof(report) - skip);
+}
+
+// press() and release() have to keep the typed keys down as well
+void HIDKeyboard::sendKeyReport(void)
+{
+    if (!backgroundTyping) {
+        sendReport();
+        return;
+    }
+    bool sent;
+    do {
+        usb_hid_lock(); // typeNext() uses typingReport
+        sent = sendTypingReport();
+        usb_hid_unlock();
+    } while (!sent);
+}
+
+void HIDKeyboard::typingCallback(void* keyboard)
+{
+    ((HIDKeyboard*)keyboard)->typeNext();
+}
+
+void HIDKeyboard::setBackgroundTyping(bool enable)
+{
+    if (enable && !backgroundTyping)
+        memset(&typingReport, 0, sizeof(typingReport));
+    backgroundTyping = enable;
+    if (enable)
+        backgroundTyping = usb_hid_add_tx_idle_callback(getHIDInstance(), typingCallback, this);
+    else
+        usb_hid_remove_tx_idle_callback(getHIDInstance(), typingCallback, this);
+}
+
+bool HIDKeyboard::queueKey(uint8_t k)
+{
+    uint8_t head = typingHead;
+    uint8_t next = (head + 1) % HID_KEYBOARD_TYPING_QUEUE_SIZE;
+    if (next == typingTail)
+        return false;
+    typingQueue[head] = k;
+    typingHead = next;
+    usb_hid_run_tx_idle_callback(getHIDInstance()); // in case the endpoint is idle
+    return true;
+}
+
+bool HIDKeyboard::isTyping(void)
+{
+    if (typingHead != typingTail)
+        return true;
+    for (unsigned i = 0; i<HID_KEYBOARD_ROLLOVER; i++)
+        if (typingReport.keys[i] != 0)
+            return true;
+    return typingReport.modifiers != 0;
 }
 
 size_t HIDKeyboard::write(uint8_t c)
 {
+    if (backgroundTyping) {
+        while (!queueKey(c)) {
+            if (!usb_hid_run_tx_idle_callback(getHIDInstance()))
+                return 0; // not running, so it would never be typed
+        }
+        return 1;
+    }
     if (press(c)) {
+        flushReport();
         release(c);		// Keyup
         return 1;
     }
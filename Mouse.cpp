@@ -1,4 +1,5 @@
 #include "USBHID.h"
+#include "usb_hid.h"
 
 //================================================================================
 //================================================================================
@@ -12,26 +13,118 @@ void HIDMouse::end(void){
 
 void HIDMouse::click(uint8_t b)
 {
+	if (accumulating) {
+		buttons(b);
+		buttons(0);
+		return;
+	}
 	_buttons = b;
 	move(0,0,0);
+	flushReport();
 	_buttons = 0;
 	move(0,0,0);
 }
 
-void HIDMouse::move(signed char x, signed char y, signed char wheel)
+static int32_t clamp(int32_t v, int32_t max)
+{
+	return v > max ? max : v < -max ? -max : v;
+}
+
+void HIDMouse::fillReport(int32_t x, int32_t y, int32_t wheel)
 {
-	reportBuffer[1] = _buttons;
-	reportBuffer[2] = x;
-	reportBuffer[3] = y;
-	reportBuffer[4] = wheel;
+	uint8_t* p = reportBuffer+1;
+	*p++ = _buttons;
+	*p++ = x;
+	if (axisBytes == 2)
+		*p++ = x >> 8;
+	*p++ = y;
+	if (axisBytes == 2)
+		*p++ = y >> 8;
+	*p = wheel;
+}
+
+void HIDMouse::move(int32_t x, int32_t y, int32_t wheel)
+{
+	if (accumulating) {
+		usb_hid_lock();
+		pendingX += x;
+		pendingY += y;
+		pendingWheel += wheel;
+		usb_hid_unlock();
+		usb_hid_run_tx_idle_callback(getHIDInstance()); // in case the endpoint is idle
+		return;
+	}
+	int32_t max = axisBytes == 2 ? 32767 : 127;
+	fillReport(clamp(x, max), clamp(y, max), clamp(wheel, 127));
 
     sendReport();
 }
 
+// Runs when the endpoint is idle: one report per poll, the rest is carried over
+void HIDMouse::sendAccumulated(void)
+{
+	if (!buttonsPending && pendingX == 0 && pendingY == 0 && pendingWheel == 0)
+		return;
+	int32_t max = axisBytes == 2 ? 32767 : 127;
+	int32_t x = clamp(pendingX, max);
+	int32_t y = clamp(pendingY, max);
+	int32_t wheel = clamp(pendingWheel, 127);
+	pendingX -= x;
+	pendingY -= y;
+	pendingWheel -= wheel;
+	buttonsPending = false;
+	fillReport(x, y, wheel);
+	sendReport();
+}
+
+void HIDMouse::accumulatedCallback(void* mouse)
+{
+	((HIDMouse*)mouse)->sendAccumulated();
+}
+
+void HIDMouse::setAccumulating(bool enable)
+{
+	if (!enable && accumulating) {
+		// let what has built up go out first
+		while (isMoving())
+			if (!usb_hid_run_tx_idle_callback(getHIDInstance()))
+				break;
+	}
+	usb_hid_lock();
+	pendingX = 0;
+	pendingY = 0;
+	pendingWheel = 0;
+	buttonsPending = false;
+	usb_hid_unlock();
+	accumulating = enable;
+	if (enable)
+		accumulating = usb_hid_add_tx_idle_callback(getHIDInstance(), accumulatedCallback, this);
+	else
+		usb_hid_remove_tx_idle_callback(getHIDInstance(), accumulatedCallback, this);
+}
+
+bool HIDMouse::isMoving(void)
+{
+	return buttonsPending || pendingX != 0 || pendingY != 0 || pendingWheel != 0;
+}
+
 void HIDMouse::buttons(uint8_t b)
 {
 	if (b != _buttons)
 	{
+		if (accumulating) {
+			// every change of the buttons gets a report of its own, so no click is lost, and the
+			// motion so far goes out first with the old buttons, so a drag ends where it should
+			while (isMoving())
+				if (!usb_hid_run_tx_idle_callback(getHIDInstance()))
+					break;
+			usb_hid_lock();
+			_buttons = b;
+			buttonsPending = true;
+			usb_hid_unlock();
+			usb_hid_run_tx_idle_callback(getHIDInstance());
+			return;
+		}
         _buttons = b;
 		move(0,0,0);
 	}
@@ -0,0 +1,107 @@
+#include "USBHID.h"
+#include <string.h>
+
+//================================================================================
+//================================================================================
+//	N-key rollover keyboard
+
+void HIDNKROKeyboard::begin(void) {
+    usb_hid_add_buffer(getHIDInstance(), HID_REPORT_TYPE_OUTPUT, &ledData);
+    if (reportID != 0) // LED reports have no report ID in the boot protocol
+        usb_hid_add_buffer(getHIDInstance(), HID_REPORT_TYPE_OUTPUT, &bootLedData);
+}
+
+uint8 HIDNKROKeyboard::getLEDs(void) {
+    if (reportID != 0 && usb_hid_get_protocol(getHIDInstance()) == 0)
+        return bootLeds[0];
+    return HIDKeyboard::getLEDs();
+}
+
+// boot protocol: up to six keys, without a report ID
+void HIDNKROKeyboard::bootReport(KeyReport_t* boot) {
+    unsigned n = 0;
+    memset(boot, 0, sizeof(*boot));
+    boot->modifiers = nkroReport.modifiers;
+    for (unsigned k = 1; k < HID_NKRO_KEYBOARD_KEYS; k++) {
+        if (nkroReport.keys[k/8] & (1 << (k%8))) {
+            if (n == HID_KEYBOARD_ROLLOVER) {
+                memset(boot->keys, 0x01, HID_KEYBOARD_ROLLOVER); // ErrorRollOver
+                break;
+            }
+            boot->keys[n++] = k;
+        }
+    }
+}
+
+void HIDNKROKeyboard::sendKeys(void) {
+    if (backgroundTyping) {
+        sendKeyReport();
+        return;
+    }
+    if (usb_hid_get_protocol(getHIDInstance()) != 0) {
+        sendReport();
+        return;
+    }
+
+    KeyReport_t boot;
+    bootReport(&boot);
+    while (!usb_hid_tx_report(getHIDInstance(), 0, (uint8_t*)&boot + 1, sizeof(boot) - 1))
+        ;
+}
+
+// The typed keys together with those held with press(), as in HIDKeyboard
+bool HIDNKROKeyboard::sendTypingReport(void) {
+    if (usb_hid_get_protocol(getHIDInstance()) == 0) {
+        KeyReport_t boot;
+        bootReport(&boot);
+        addTypedKeys(&boot);
+        return usb_hid_tx_report(getHIDInstance(), 0, (uint8_t*)&boot + 1, sizeof(boot) - 1);
+    }
+
+    NKROKeyReport_t report = nkroReport;
+    report.reportID = reportID;
+    report.modifiers |= typingReport.modifiers;
+    for (unsigned i = 0; i < HID_KEYBOARD_ROLLOVER; i++) {
+        uint8_t k = typingReport.keys[i];
+        if (k != 0 && k < HID_NKRO_KEYBOARD_KEYS)
+            report.keys[k/8] |= 1 << (k%8);
+    }
+    unsigned skip = reportID == 0;
+    return usb_hid_tx_report(getHIDInstance(), reportID, (uint8_t*)&report + skip, sizeof(report) - skip);
+}
+
+size_t HIDNKROKeyboard::press(uint8_t k) {
+    uint8_t modifiers;
+
+    k = getKeyCode(k, &modifiers);
+
+    if ((k == 0 && modifiers == 0) || k >= HID_NKRO_KEYBOARD_KEYS)
+        return 0;
+
+    if (k != 0)
+        nkroReport.keys[k/8] |= 1 << (k%8);
+    nkroReport.modifiers |= modifiers;
+    sendKeys();
+    return 1;
+}
+
+size_t HIDNKROKeyboard::release(uint8_t k) {
+    uint8_t modifiers;
+
+    k = getKeyCode(k, &modifiers);
+
+    if ((k == 0 && modifiers == 0) || k >= HID_NKRO_KEYBOARD_KEYS)
+        return 0;
+
+    if (k != 0)
+        nkroReport.keys[k/8] &= ~(1 << (k%8));
+    nkroReport.modifiers &= ~modifiers;
+    sendKeys();
+    return 1;
+}
+
+void HIDNKROKeyboard::releaseAll(void) {
+    memset(nkroReport.keys, 0, sizeof(nkroReport.keys));
+    nkroReport.modifiers = 0;
+    sendKeys();
+}
@@ -1,4 +1,5 @@
 #include "USBComposite.h"
+#include <stdlib.h>
 
 #define DEFAULT_VENDOR_ID  0x1EAF
 #define DEFAULT_PRODUCT_ID 0x0004
@@ -97,19 +98,45 @@ void USBCompositeDevice::setSerialString(const char* s) {
     }
 }
 
-bool USBCompositeDevice::begin() {
-   if (enabled)
-        return true;
+bool USBCompositeDevice::initParts() {
 	usb_generic_set_info(vendorId, productId, iManufacturer[0] ? iManufacturer : NULL, iProduct[0] ? iProduct : NULL, 
         haveSerialNumber ? iSerialNumber : NULL);
     for (uint32 i = 0 ; i < numParts ; i++) {
-		if (init[i] != NULL && !init[i](plugin[i]))
+		if (init[i] != NULL && !init[i](plugin[i])) {
+			stopParts(i); // those already started
 			return false;
+		}
 	}
-    if (! usb_generic_set_parts(parts, numParts))
+    return true;
+}
+
+void USBCompositeDevice::stopParts(uint32 count) {
+    for (uint32 i = 0 ; i < count ; i++)
+		if (stop[i] != NULL)
+			stop[i](plugin[i]);
+}
+
+bool USBCompositeDevice::begin() {
+   if (enabled)
+        return true;
+    if (! initParts())
+        return false;
+    if (! usb_generic_get_fast_attach() || ! usb_generic_config_cached() || partsChanged()) {
+        if (! usb_generic_set_parts(parts, numParts)) {
+            stopParts(numParts);
+            return false;
+        }
+        memcpy(configuredParts, parts, sizeof(parts));
+        numConfiguredParts = numParts;
+    }
+    if (! assignArena()) {
+        stopParts(numParts);
         return false;
+    }
+    switchStart = usb_generic_micros();
     usb_generic_enable();
     enabled = true;  
+    profile = NULL; // not a saved profile any more, even if the parts are the same
     return true;
 }
 
@@ -117,12 +144,143 @@ void USBCompositeDevice::end() {
     if (!enabled)
         return;
     usb_generic_disable();
-    for (uint32 i = 0 ; i < numParts ; i++)
-		if (stop[i] != NULL)
-			stop[i](plugin[i]);
+    stopParts(numParts);
+    releaseArena();
     enabled = false;
 }
 
+/* Builds the configuration for the currently registered parts and keeps it,
+ * along with the parts, in profile. Only valid while the device is not
+ * running; changing the HID report descriptor afterwards means the profile
+ * has to be saved again. */
+bool USBCompositeDevice::saveProfile(USBCompositeProfile& p) {
+    if (enabled)
+        return false;
+    if (! usb_generic_set_parts(parts, numParts)) {
+        p.prepared = false;
+        return false;
+    }
+    memcpy(configuredParts, parts, sizeof(parts));
+    numConfiguredParts = numParts;
+    usb_generic_save_layout(&p.layout);
+    p.vendorId = vendorId;
+    p.productId = productId;
+    memcpy(p.parts, parts, sizeof(parts));
+    memcpy(p.init, init, sizeof(init));
+    memcpy(p.stop, stop, sizeof(stop));
+    memcpy(p.plugin, plugin, sizeof(plugin));
+    p.numParts = numParts;
+    p.prepared = true;
+    return true;
+}
+
+bool USBCompositeDevice::startProfile(USBCompositeProfile& p) {
+    vendorId = p.vendorId;
+    productId = p.productId;
+    memcpy(parts, p.parts, sizeof(parts));
+    memcpy(init, p.init, sizeof(init));
+    memcpy(stop, p.stop, sizeof(stop));
+    memcpy(plugin, p.plugin, sizeof(plugin));
+    numParts = p.numParts;
+    if (! initParts())
+        return false;
+    usb_generic_load_layout(&p.layout, parts, numParts);
+    memcpy(configuredParts, parts, sizeof(parts));
+    numConfiguredParts = numParts;
+    if (! assignArena()) {
+        stopParts(numParts);
+        return false;
+    }
+    usb_generic_enable();
+    enabled = true;
+    return true;
+}
+
+/* Disconnects, switches to a saved profile and re-enumerates. Descriptors
+ * are not rebuilt; only the parts' init functions are run again, and the
+ * parts get back the state (report descriptors, buffer sizes) they had when
+ * the profile was saved. If the profile cannot be started, false is returned,
+ * and a device that was running a profile goes back to it; one started with
+ * begin() stays disconnected. */
+bool USBCompositeDevice::switchProfile(USBCompositeProfile& p) {
+    if (! p.prepared)
+        return false;
+    USBCompositeProfile* previous = enabled ? profile : NULL;
+    switchStart = usb_generic_micros();
+    end();
+    profile = NULL;
+    if (startProfile(p)) {
+        profile = &p;
+        return true;
+    }
+    if (previous != NULL && startProfile(*previous))
+        profile = previous;
+    return false;
+}
+
+/* Microseconds from the last begin() or switchProfile() call until the host
+ * configured the device, or 0 if it has not done so yet. */
+uint32 USBCompositeDevice::getSwitchTime() {
+    const USBTimelineEvent* events;
+    uint32 n = usb_generic_get_timeline(&events);
+    for (uint32 i = 0 ; i < n ; i++)
+        if (events[i].event == USB_TIMELINE_CONFIGURED)
+            return events[i].micros - switchStart;
+    return 0;
+}
+
+/* Buffers of the running parts (rings, block buffers) are carved out of
+ * this memory, which should be 4-byte aligned and at least getArenaSize()
+ * bytes. Parts that are not running use none of it, so configurations that
+ * are never active at the same time can share the arena. With no arena set
+ * the buffers are allocated with malloc() in begin() and freed in end(). */
+void USBCompositeDevice::setArena(void* memory, uint32 size) {
+    arena = (uint8*)memory;
+    arenaSize = size;
+}
+
+#define ARENA_ALIGN(n) (((n)+3)/4*4)
+
+uint32 USBCompositeDevice::getArenaSize() {
+    uint32 size = 0;
+    for (uint32 i = 0 ; i < numParts ; i++)
+        if (parts[i]->usbSetArena != NULL)
+            size += ARENA_ALIGN(parts[i]->arenaSize);
+    return size;
+}
+
+bool USBCompositeDevice::assignArena() {
+    uint32 size = getArenaSize();
+    uint8* memory = arena;
+    if (memory == NULL) {
+        memory = allocatedArena = (uint8*)malloc(size);
+        if (allocatedArena == NULL && size > 0)
+            return false;
+    }
+    else if (size > arenaSize) {
+        return false;
+    }
+    for (uint32 i = 0 ; i < numParts ; i++) {
+        if (parts[i]->usbSetArena != NULL) {
+            parts[i]->usbSetArena(memory);
+            memory += ARENA_ALIGN(parts[i]->arenaSize);
+        }
+    }
+    return true;
+}
+
+void USBCompositeDevice::releaseArena() {
+    for (uint32 i = 0 ; i < numParts ; i++)
+        if (parts[i]->usbSetArena != NULL)
+            parts[i]->usbSetArena(NULL);
+    free(allocatedArena);
+    allocatedArena = NULL;
+}
+
+bool USBCompositeDevice::partsChanged() {
+    return numParts != numConfiguredParts || memcmp(parts, configuredParts, numParts * sizeof(*parts));
+}
+
 void USBCompositeDevice::clear() {
     numParts = 0;
 }
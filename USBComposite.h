@@ -20,7 +20,7 @@
 // and hence burning it for cryptographic purposes.
 const char* getDeviceIDString();
 
-#define USB_COMPOSITE_MAX_PARTS 6
+#define USB_COMPOSITE_MAX_PARTS USB_GENERIC_MAX_PARTS
 
 class USBCompositeDevice;
 
@@ -29,6 +29,31 @@ class USBCompositeDevice;
 typedef bool(*USBPartInitializer)(void*);
 typedef void(*USBPartStopper)(void*);
 
+// A set of registered parts together with their precomputed descriptors,
+// endpoint table and PMA layout. See USBCompositeDevice::saveProfile().
+class USBCompositeProfile {
+    friend class USBCompositeDevice;
+private:
+    const char* name;
+    bool prepared = false;
+    uint16 vendorId;
+    uint16 productId;
+    USBCompositePart* parts[USB_COMPOSITE_MAX_PARTS];
+	USBPartInitializer init[USB_COMPOSITE_MAX_PARTS];
+	USBPartStopper stop[USB_COMPOSITE_MAX_PARTS];
+	void* plugin[USB_COMPOSITE_MAX_PARTS];
+    uint32 numParts;
+    USBGenericLayout layout;
+public:
+    USBCompositeProfile(const char* _name = NULL) : name(_name) {}
+    const char* getName() {
+        return name;
+    }
+    bool isPrepared() {
+        return prepared;
+    }
+};
+
 class USBCompositeDevice {
 private:
 	bool enabled = false;
@@ -43,6 +68,19 @@ private:
 	USBPartStopper stop[USB_COMPOSITE_MAX_PARTS];
 	void* plugin[USB_COMPOSITE_MAX_PARTS];
     uint32 numParts;
+    USBCompositePart* configuredParts[USB_COMPOSITE_MAX_PARTS];
+    uint32 numConfiguredParts = 0;
+    USBCompositeProfile* profile = NULL;
+    uint32 switchStart = 0;
+    uint8* arena = NULL;
+    uint32 arenaSize = 0;
+    uint8* allocatedArena = NULL;
+    bool partsChanged();
+    bool initParts();
+    void stopParts(uint32 count);
+    bool startProfile(USBCompositeProfile& p);
+    bool assignArena();
+    void releaseArena();
 public:
 	USBCompositeDevice(void); 
     void setVendorId(uint16 vendor=0);
@@ -53,10 +91,29 @@ public:
     bool begin(void);
     void end(void);
     void clear();
+    void setArena(void* memory, uint32 size);
+    uint32 getArenaSize();
     bool isReady() {
         return enabled && usb_is_connected(USBLIB) && usb_is_configured(USBLIB);    
     }
     bool add(USBCompositePart* part, void* plugin, USBPartInitializer init = NULL, USBPartStopper stop = NULL);
+    void setFastAttach(bool fast) {
+        usb_generic_set_fast_attach(fast);
+    }
+    bool getFastAttach() {
+        return usb_generic_get_fast_attach();
+    }
+    bool saveProfile(USBCompositeProfile& profile);
+    bool switchProfile(USBCompositeProfile& profile);
+    USBCompositeProfile* getProfile() {
+        return profile;
+    }
+    // microseconds from the last begin() or switchProfile() until the host configured the device
+    uint32 getSwitchTime();
+    // enumeration events recorded since the last begin()
+    uint32 getTimeline(const USBTimelineEvent** events) {
+        return usb_generic_get_timeline(events);
+    }
 };
 
 extern USBCompositeDevice USBComposite;
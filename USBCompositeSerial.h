@@ -12,6 +12,10 @@ public:
 	void end();
 	static bool init(USBCompositeSerial* me);
 	bool registerComponent();
+	// rounded up to powers of 2; take effect at the next begin()
+	void setBufferSizes(uint32 rxSize, uint32 txSize) {
+		composite_cdcacm_set_buffer_sizes(rxSize, txSize);
+	}
 
 	operator bool() { return true; } // Roger Clark. This is needed because in cardinfo.ino it does if (!Serial) . It seems to be a work around for the Leonardo that we needed to implement just to be compliant with the API
 
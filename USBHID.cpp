@@ -34,11 +34,11 @@
  */
 
 bool USBHIDDevice::registerComponent() {
-	return USBComposite.add(&usbHIDPart, this);
+	return USBComposite.add(&usbHIDParts[instance], this);
 }
 
 void USBHIDDevice::setReportDescriptor(const uint8_t* report_descriptor, uint16_t report_descriptor_length) {
-	usb_hid_set_report_descriptor(report_descriptor, report_descriptor_length);
+	usb_hid_set_report_descriptor(instance, report_descriptor, report_descriptor_length);
 }
 
 void USBHIDDevice::setReportDescriptor(const HIDReportDescriptor* report) {
@@ -72,15 +72,15 @@ void USBHIDDevice::begin(const HIDReportDescriptor* report, uint16_t idVendor, u
 }
 
 void USBHIDDevice::setBuffers(uint8_t type, volatile HIDBuffer_t* fb, int count) {
-    usb_hid_set_buffers(type, fb, count);
+    usb_hid_set_buffers(instance, type, fb, count);
 }
 
 bool USBHIDDevice::addBuffer(uint8_t type, volatile HIDBuffer_t* buffer) {
-    return 0 != usb_hid_add_buffer(type, buffer);
+    return 0 != usb_hid_add_buffer(instance, type, buffer);
 }
 
 void USBHIDDevice::clearBuffers(uint8_t type) {
-	usb_hid_clear_buffers(type);
+	usb_hid_clear_buffers(instance, type);
 }
 
 void USBHIDDevice::clearBuffers() {
@@ -99,20 +99,28 @@ void HIDReporter::sendReport() {
 //    while (usb_is_transmitting() != 0) {
 //    }
 
-    unsigned toSend = bufferSize;
-    uint8* b = buffer;
-    
-    while (toSend) {
-        unsigned delta = usb_hid_tx(b, toSend);
-        toSend -= delta;
-        b += delta;
-    }
-    
-//    while (usb_is_transmitting() != 0) {
-//    }
+    while (! usb_hid_tx_report(instance, reportID, buffer, bufferSize))
+        ;
+}
+
+bool HIDReporter::setReportQueue(uint8_t policy, uint8_t depth) {
+    if (depth == 0)
+        return clearReportQueue();
+    if (! usb_hid_set_report_queue(instance, reportID, bufferSize, policy, depth))
+        return false;
+    queuePolicy = policy;
+    return true;
+}
+
+bool HIDReporter::clearReportQueue() {
+    usb_hid_set_report_queue(instance, reportID, 0, 0, 0);
+    queuePolicy = -1;
+    return true;
+}
 
-    /* flush out to avoid having the pc wait for more data */
-    usb_hid_tx(NULL, 0);
+void HIDReporter::flushReport() {
+    while (usb_hid_report_pending(instance, reportID))
+        ;
 }
         
 HIDReporter::HIDReporter(uint8_t* _buffer, unsigned _size, uint8_t _reportID) {
@@ -137,20 +145,20 @@ HIDReporter::HIDReporter(uint8_t* _buffer, unsigned _size) {
     reportID = 0;
 }
 
-void HIDReporter::setFeature(uint8_t* in) {
-    return usb_hid_set_feature(reportID, in);
+bool HIDReporter::setFeature(const uint8_t* in) {
+    return usb_hid_set_feature(instance, reportID, in);
 }
 
 uint16_t HIDReporter::getData(uint8_t type, uint8_t* out, uint8_t poll) {
-    return usb_hid_get_data(type, reportID, out, poll);
+    return usb_hid_get_data(instance, type, reportID, out, poll);
 }
 
 uint16_t HIDReporter::getFeature(uint8_t* out, uint8_t poll) {
-    return usb_hid_get_data(HID_REPORT_TYPE_FEATURE, reportID, out, poll);
+    return usb_hid_get_data(instance, HID_REPORT_TYPE_FEATURE, reportID, out, poll);
 }
 
 uint16_t HIDReporter::getOutput(uint8_t* out, uint8_t poll) {
-    return usb_hid_get_data(HID_REPORT_TYPE_OUTPUT, reportID, out, poll);
+    return usb_hid_get_data(instance, HID_REPORT_TYPE_OUTPUT, reportID, out, poll);
 }
 
 USBHIDDevice USBHID;
@@ -32,8 +32,20 @@
 #define HID_KEYBOARD_REPORT_ID 2
 #define HID_CONSUMER_REPORT_ID 3
 #define HID_JOYSTICK_REPORT_ID 20
+#define HID_DIGITIZER_REPORT_ID 4
+#define HID_REGISTER_MAP_REPORT_ID 30 // the data report has the next ID
 
 #define HID_KEYBOARD_ROLLOVER 6
+#define HID_NKRO_KEYBOARD_KEYS 128 // bitmap of usages 0 to 127, a multiple of 8
+#ifndef HID_DIGITIZER_CONTACTS
+#define HID_DIGITIZER_CONTACTS 10 // for HID_DIGITIZER and HIDDigitizer<>
+#endif
+#ifndef HID_REGISTER_MAP_BLOCK_SIZE
+#define HID_REGISTER_MAP_BLOCK_SIZE 63 // bytes of the table per data report
+#endif
+#ifndef HID_KEYBOARD_TYPING_QUEUE_SIZE
+#define HID_KEYBOARD_TYPING_QUEUE_SIZE 32 // at most 256
+#endif
 
 #define MACRO_GET_ARGUMENT_2(x, y, ...) y
 #define MACRO_GET_ARGUMENT_1_WITH_DEFAULT(default, ...) MACRO_GET_ARGUMENT_2(placeholder, ## __VA_ARGS__, default)
@@ -106,6 +118,40 @@
     MACRO_ARGUMENT_2_TO_END(__VA_ARGS__)  \
     0xc0      						/*  END_COLLECTION */ 
 
+// Like HID_MOUSE_REPORT_DESCRIPTOR, but with 16-bit X and Y for high resolution sensors (use HIDMouse16)
+#define HID_MOUSE16_REPORT_DESCRIPTOR(...) \
+    0x05, 0x01,						/*  USAGE_PAGE (Generic Desktop) */ \
+    0x09, 0x02,						/*  USAGE (Mouse) */ \
+    0xa1, 0x01,						/*  COLLECTION (Application) */ \
+    0x85, MACRO_GET_ARGUMENT_1_WITH_DEFAULT(HID_MOUSE_REPORT_ID, ## __VA_ARGS__),  /*    REPORT_ID */ \
+    0x09, 0x01,						/*    USAGE (Pointer) */ \
+    0xa1, 0x00,						/*    COLLECTION (Physical) */ \
+    0x05, 0x09,						/*      USAGE_PAGE (Button) */ \
+    0x19, 0x01,						/*      USAGE_MINIMUM (Button 1) */ \
+    0x29, 0x08,						/*      USAGE_MAXIMUM (Button 8) */ \
+    0x15, 0x00,						/*      LOGICAL_MINIMUM (0) */ \
+    0x25, 0x01,						/*      LOGICAL_MAXIMUM (1) */ \
+    0x95, 0x08,						/*      REPORT_COUNT (8) */ \
+    0x75, 0x01,						/*      REPORT_SIZE (1) */ \
+    0x81, 0x02,						/*      INPUT (Data,Var,Abs) */ \
+    0x05, 0x01,						/*      USAGE_PAGE (Generic Desktop) */ \
+    0x09, 0x30,						/*      USAGE (X) */ \
+    0x09, 0x31,						/*      USAGE (Y) */ \
+    0x16, 0x01, 0x80,						/*      LOGICAL_MINIMUM (-32767) */ \
+    0x26, 0xFF, 0x7f,						/*      LOGICAL_MAXIMUM (32767) */ \
+    0x75, 0x10,						/*      REPORT_SIZE (16) */ \
+    0x95, 0x02,						/*      REPORT_COUNT (2) */ \
+    0x81, 0x06,						/*      INPUT (Data,Var,Rel) */ \
+    0x09, 0x38,						/*      USAGE (Wheel) */ \
+    0x15, 0x81,						/*      LOGICAL_MINIMUM (-127) */ \
+    0x25, 0x7f,						/*      LOGICAL_MAXIMUM (127) */ \
+    0x75, 0x08,						/*      REPORT_SIZE (8) */ \
+    0x95, 0x01,						/*      REPORT_COUNT (1) */ \
+    0x81, 0x06,						/*      INPUT (Data,Var,Rel) */ \
+    0xc0,      						/*    END_COLLECTION */ \
+    MACRO_ARGUMENT_2_TO_END(__VA_ARGS__)  \
+    0xc0      						/*  END_COLLECTION */
+
 #define HID_ABS_MOUSE_REPORT_DESCRIPTOR(...) \
     0x05, 0x01,						/*  USAGE_PAGE (Generic Desktop)	// 54 */ \
     0x09, 0x02,						/*  USAGE (Mouse) */ \
@@ -139,6 +185,66 @@
     MACRO_ARGUMENT_2_TO_END(__VA_ARGS__)  \
     0xc0      						/*  END_COLLECTION */ 
 
+// One finger of HID_DIGITIZER_REPORT_DESCRIPTOR: tip switch, contact ID, X and Y
+#define HID_DIGITIZER_CONTACT_DESCRIPTOR \
+    0x09, 0x22,						/*    USAGE (Finger) */ \
+    0xa1, 0x02,						/*    COLLECTION (Logical) */ \
+    0x09, 0x42,						/*      USAGE (Tip Switch) */ \
+    0x15, 0x00,						/*      LOGICAL_MINIMUM (0) */ \
+    0x25, 0x01,						/*      LOGICAL_MAXIMUM (1) */ \
+    0x75, 0x01,						/*      REPORT_SIZE (1) */ \
+    0x95, 0x01,						/*      REPORT_COUNT (1) */ \
+    0x81, 0x02,						/*      INPUT (Data,Var,Abs) */ \
+    0x95, 0x07,						/*      REPORT_COUNT (7) */ \
+    0x81, 0x03,						/*      INPUT (Cnst,Var,Abs) */ \
+    0x95, 0x01,						/*      REPORT_COUNT (1) */ \
+    0x09, 0x51,						/*      USAGE (Contact Identifier) */ \
+    0x26, 0xFF, 0x00,					/*      LOGICAL_MAXIMUM (255) */ \
+    0x75, 0x08,						/*      REPORT_SIZE (8) */ \
+    0x81, 0x02,						/*      INPUT (Data,Var,Abs) */ \
+    0x05, 0x01,						/*      USAGE_PAGE (Generic Desktop) */ \
+    0x26, 0xFF, 0x7f,					/*      LOGICAL_MAXIMUM (32767) */ \
+    0x75, 0x10,						/*      REPORT_SIZE (16) */ \
+    0x09, 0x30,						/*      USAGE (X) */ \
+    0x81, 0x02,						/*      INPUT (Data,Var,Abs) */ \
+    0x09, 0x31,						/*      USAGE (Y) */ \
+    0x81, 0x02,						/*      INPUT (Data,Var,Abs) */ \
+    0x05, 0x0d,						/*      USAGE_PAGE (Digitizer) */ \
+    0xc0,						/*    END_COLLECTION */
+
+#define HID_DIGITIZER_CONTACTS_1 HID_DIGITIZER_CONTACT_DESCRIPTOR
+#define HID_DIGITIZER_CONTACTS_2 HID_DIGITIZER_CONTACTS_1 HID_DIGITIZER_CONTACT_DESCRIPTOR
+#define HID_DIGITIZER_CONTACTS_3 HID_DIGITIZER_CONTACTS_2 HID_DIGITIZER_CONTACT_DESCRIPTOR
+#define HID_DIGITIZER_CONTACTS_4 HID_DIGITIZER_CONTACTS_3 HID_DIGITIZER_CONTACT_DESCRIPTOR
+#define HID_DIGITIZER_CONTACTS_5 HID_DIGITIZER_CONTACTS_4 HID_DIGITIZER_CONTACT_DESCRIPTOR
+#define HID_DIGITIZER_CONTACTS_6 HID_DIGITIZER_CONTACTS_5 HID_DIGITIZER_CONTACT_DESCRIPTOR
+#define HID_DIGITIZER_CONTACTS_7 HID_DIGITIZER_CONTACTS_6 HID_DIGITIZER_CONTACT_DESCRIPTOR
+#define HID_DIGITIZER_CONTACTS_8 HID_DIGITIZER_CONTACTS_7 HID_DIGITIZER_CONTACT_DESCRIPTOR
+#define HID_DIGITIZER_CONTACTS_9 HID_DIGITIZER_CONTACTS_8 HID_DIGITIZER_CONTACT_DESCRIPTOR
+#define HID_DIGITIZER_CONTACTS_10 HID_DIGITIZER_CONTACTS_9 HID_DIGITIZER_CONTACT_DESCRIPTOR
+#define HID_DIGITIZER_CONTACTS_DESCRIPTOR(n) HID_DIGITIZER_CONTACTS_DESCRIPTOR_(n)
+#define HID_DIGITIZER_CONTACTS_DESCRIPTOR_(n) HID_DIGITIZER_CONTACTS_ ## n
+
+/* A touch screen reporting up to contacts (1 to 10, a plain number) fingers at
+ * once, all in one report, followed by the number of them touching. The
+ * feature report with the same ID gives the maximum, as Windows asks for it. */
+#define HID_DIGITIZER_REPORT_DESCRIPTOR(contacts, ...) \
+    0x05, 0x0d,						/*  USAGE_PAGE (Digitizer) */ \
+    0x09, 0x04,						/*  USAGE (Touch Screen) */ \
+    0xa1, 0x01,						/*  COLLECTION (Application) */ \
+    0x85, MACRO_GET_ARGUMENT_1_WITH_DEFAULT(HID_DIGITIZER_REPORT_ID, ## __VA_ARGS__),  /*    REPORT_ID */ \
+    HID_DIGITIZER_CONTACTS_DESCRIPTOR(contacts) \
+    0x09, 0x54,						/*    USAGE (Contact Count) */ \
+    0x15, 0x00,						/*    LOGICAL_MINIMUM (0) */ \
+    0x25, contacts,					/*    LOGICAL_MAXIMUM (contacts) */ \
+    0x75, 0x08,						/*    REPORT_SIZE (8) */ \
+    0x95, 0x01,						/*    REPORT_COUNT (1) */ \
+    0x81, 0x02,						/*    INPUT (Data,Var,Abs) */ \
+    0x09, 0x55,						/*    USAGE (Contact Count Maximum) */ \
+    0xb1, 0x02,						/*    FEATURE (Data,Var,Abs) */ \
+    MACRO_ARGUMENT_2_TO_END(__VA_ARGS__)  \
+    0xc0						/*  END_COLLECTION */
+
 #define HID_KEYBOARD_REPORT_DESCRIPTOR(...) \
     0x05, 0x01,						/*  USAGE_PAGE (Generic Desktop)	// 47 */ \
     0x09, 0x06,						/*  USAGE (Keyboard) */ \
@@ -176,6 +282,35 @@
     MACRO_ARGUMENT_2_TO_END(__VA_ARGS__)  \
     0xc0      						/*  END_COLLECTION */
     
+// One bit per key, so any number of keys can be down at once
+#define HID_NKRO_KEYBOARD_REPORT_DESCRIPTOR(...) \
+    0x05, 0x01,						/*  USAGE_PAGE (Generic Desktop) */ \
+    0x09, 0x06,						/*  USAGE (Keyboard) */ \
+    0xa1, 0x01,						/*  COLLECTION (Application) */ \
+    0x85, MACRO_GET_ARGUMENT_1_WITH_DEFAULT(HID_KEYBOARD_REPORT_ID, ## __VA_ARGS__),  /*    REPORT_ID */ \
+    0x05, 0x07,						/*    USAGE_PAGE (Keyboard) */ \
+	0x19, 0xe0,						/*    USAGE_MINIMUM (Keyboard LeftControl) */ \
+    0x29, 0xe7,						/*    USAGE_MAXIMUM (Keyboard Right GUI) */ \
+    0x15, 0x00,						/*    LOGICAL_MINIMUM (0) */ \
+    0x25, 0x01,						/*    LOGICAL_MAXIMUM (1) */ \
+    0x75, 0x01,						/*    REPORT_SIZE (1) */ \
+	0x95, 0x08,						/*    REPORT_COUNT (8) */ \
+    0x81, 0x02,						/*    INPUT (Data,Var,Abs) */ \
+\
+	0x19, 0x00,						/*    USAGE_MINIMUM (0) */ \
+    0x29, HID_NKRO_KEYBOARD_KEYS-1,	/*    USAGE_MAXIMUM (127) */ \
+	0x95, HID_NKRO_KEYBOARD_KEYS,	/*    REPORT_COUNT (128) */ \
+    0x81, 0x02,						/*    INPUT (Data,Var,Abs) */ \
+\
+	0x05, 0x08,						 /*   USAGE_PAGE (LEDs) */ \
+	0x19, 0x01,						 /*   USAGE_MINIMUM (Num Lock) */ \
+	0x29, 0x08,						 /*   USAGE_MAXIMUM (Kana + 3 custom)*/ \
+	0x95, 0x08,						 /*   REPORT_COUNT (8) */ \
+	0x75, 0x01,						 /*   REPORT_SIZE (1) */ \
+	0x91, 0x02,						 /*   OUTPUT (Data,Var,Abs) */    \
+    MACRO_ARGUMENT_2_TO_END(__VA_ARGS__)  \
+    0xc0      						/*  END_COLLECTION */
+
 #define HID_BOOT_KEYBOARD_REPORT_DESCRIPTOR(...) \
     0x05, 0x01,						/*  USAGE_PAGE (Generic Desktop)	// 47 */ \
     0x09, 0x06,						/*  USAGE (Keyboard) */ \
@@ -263,7 +398,7 @@
     
 #define LSB(x) ((x) & 0xFF)    
 #define MSB(x) (((x) & 0xFF00) >> 8)    
-// TODO: make this work for txSize > 255
+// report counts are two bytes, so either size can go up to 65535 (the host may have its own limit)
 #define HID_RAW_REPORT_DESCRIPTOR(txSize, rxSize) \
 	0x06, LSB(RAWHID_USAGE_PAGE), MSB(RAWHID_USAGE_PAGE), \
 	0x0A, LSB(RAWHID_USAGE), MSB(RAWHID_USAGE), \
@@ -284,6 +419,47 @@
 	0x09, 0x02,				/*  usage */ \
 	0x91, 0x02,				/*  OUTPUT (0x91) */ \
 	0xC0					/*  end collection */ 
+
+// Input-only raw report for HIDRawStream, one per interface it spreads the stream over
+#define RAWHID_STREAM_USAGE	0x0C01
+#define HID_RAW_STREAM_REPORT_DESCRIPTOR(size) \
+	0x06, LSB(RAWHID_USAGE_PAGE), MSB(RAWHID_USAGE_PAGE), \
+	0x0A, LSB(RAWHID_STREAM_USAGE), MSB(RAWHID_STREAM_USAGE), \
+	0xA1, 0x01,				/*  Collection 0x01 */ \
+	0x75, 0x08,				/*  report size = 8 bits */ \
+	0x15, 0x00,				/*  logical minimum = 0 */ \
+	0x26, 0xFF, 0x00,		/*  logical maximum = 255 */ \
+	0x96, LSB(size), MSB(size),				/*  report count */ \
+	0x09, 0x01,				/*  usage */ \
+	0x81, 0x02,				/*  Input (array) */ \
+	0xC0					/*  end collection */ 
+
+// Window and data feature reports for HIDRegisterMap<blockSize>
+#define HID_REGISTER_MAP_USAGE	0x0C02
+#define HID_REGISTER_MAP_REPORT_DESCRIPTOR(blockSize, ...) \
+	0x06, LSB(RAWHID_USAGE_PAGE), MSB(RAWHID_USAGE_PAGE), \
+	0x0A, LSB(HID_REGISTER_MAP_USAGE), MSB(HID_REGISTER_MAP_USAGE), \
+	0xA1, 0x01,				/*  Collection 0x01 */ \
+	0x85, MACRO_GET_ARGUMENT_1_WITH_DEFAULT(HID_REGISTER_MAP_REPORT_ID, ## __VA_ARGS__),  /*    REPORT_ID */ \
+	0x75, 0x08,				/*  report size = 8 bits */ \
+	0x15, 0x00,				/*  logical minimum = 0 */ \
+	0x26, 0xFF, 0x00,		/*  logical maximum = 255 */ \
+	0x95, sizeof(HIDRegisterWindow_t),	/*  report count (window) */ \
+	0x09, 0x01,				/*  usage */ \
+	0xB1, 0x02,				/*  Feature (Data,Var,Abs) */ \
+	0x85, MACRO_GET_ARGUMENT_1_WITH_DEFAULT(HID_REGISTER_MAP_REPORT_ID, ## __VA_ARGS__)+1,  /*    REPORT_ID */ \
+	0x96, LSB(blockSize), MSB(blockSize),	/*  report count (data) */ \
+	0x09, 0x02,				/*  usage */ \
+	0xB1, 0x02,				/*  Feature (Data,Var,Abs) */ \
+	0xC0					/*  end collection */ 
+
+// the window report of HID_REGISTER_MAP_REPORT_DESCRIPTOR, little-endian
+typedef struct {
+    uint16_t address;
+    uint16_t length;
+    uint16_t size;    // of the table, read only
+    uint32_t changed; // read only, see HIDRegisterMap
+} __packed HIDRegisterWindow_t;
     
 typedef struct {
     uint8_t* descriptor;
@@ -293,7 +469,15 @@ typedef struct {
 class USBHIDDevice {
 private:
 	bool enabledHID = false;
+    uint8_t instance;
 public:
+    // Up to USB_HID_MAX_INSTANCES devices (1 unless the build defines more), each registering
+    // its own HID interface, report descriptor and endpoint with USBComposite. USBHID is
+    // instance 0.
+    USBHIDDevice(uint8_t _instance=0) : instance(_instance < USB_HID_MAX_INSTANCES ? _instance : 0) {}
+    inline uint8_t getInstance() {
+        return instance;
+    }
 	bool registerComponent();
 	void setReportDescriptor(const uint8_t* report_descriptor, uint16_t report_descriptor_length);
 	void setReportDescriptor(const HIDReportDescriptor* reportDescriptor);
@@ -319,6 +503,42 @@ public:
     inline void setOutputBuffers(volatile HIDBuffer_t* fb=NULL, int count=0) {
         setBuffers(HID_REPORT_TYPE_OUTPUT, fb, count);
     }     
+    // rounded up to a power of 2; takes effect at the next begin()
+    inline void setTxBufferSize(uint32 size) {
+        usb_hid_set_tx_buffer_size(instance, size);
+    }
+    // in ms; takes effect at the next begin()
+    inline void setPollInterval(uint8 interval) {
+        usb_hid_set_poll_interval(instance, interval);
+    }
+    // output reports through an interrupt OUT endpoint as well as SET_REPORT; takes effect at the next begin()
+    inline void setOutEndpoint(bool enable) {
+        usb_hid_set_out_endpoint(instance, enable);
+    }
+    // HID_INTERFACE_PROTOCOL_KEYBOARD or _MOUSE makes the interface a boot device; takes effect at the next begin()
+    inline void setInterfaceProtocol(uint8 protocol) {
+        usb_hid_set_interface_protocol(instance, protocol);
+    }
+    // 0 if the host has selected the boot protocol
+    inline uint8 getProtocol(void) {
+        return usb_hid_get_protocol(instance);
+    }
+    // Calls callback(context, data, length) when the host writes the output or feature buffer with
+    // reportID (added beforehand), from the USB interrupt, or if deferred, from runBufferCallbacks()
+    inline bool setBufferCallback(uint8_t type, uint8_t reportID, HIDBufferCallback callback, void* context=NULL, bool deferred=false) {
+        return usb_hid_set_buffer_callback(instance, type, reportID, callback, context, deferred);
+    }
+    inline void runBufferCallbacks(void) {
+        usb_hid_run_buffer_callbacks(instance);
+    }
+    // Sets what the host reads from the feature buffer with reportID (see usb_hid_set_feature())
+    inline bool setFeature(uint8_t reportID, const uint8_t* data) {
+        return usb_hid_set_feature(instance, reportID, data);
+    }
+    // Repeats reports with a queue at the idle rate the host has set (SET_IDLE); call it from loop()
+    inline void sendIdleReports(void) {
+        usb_hid_send_idle_reports(instance);
+    }
     void end(void);
 };
 
@@ -332,9 +552,48 @@ class HIDReporter {
         uint8_t* buffer;
         unsigned bufferSize;
         uint8_t reportID;
+        uint8_t instance = 0;
+        int16_t queuePolicy = -1;
         
     public:
         void sendReport(); 
+        // reports go to USBHID unless set otherwise here
+        inline void setHID(USBHIDDevice& device) {
+            instance = device.getInstance();
+        }
+        inline uint8_t getHIDInstance() {
+            return instance;
+        }
+        inline uint8_t getReportID() {
+            return reportID;
+        }
+        // Gives this report ID a queue of depth report slots of its own, with policy HID_QUEUE_FIFO,
+        // HID_QUEUE_KEEP_LATEST or HID_QUEUE_DROP_DUPLICATE (see usb_hid_set_report_queue()). Without
+        // one, reports share the tx buffer in FIFO order. Takes effect at the next begin(); reports
+        // must fit in one packet (USB_HID_TX_EPSIZE bytes).
+        bool setReportQueue(uint8_t policy, uint8_t depth=1);
+        bool clearReportQueue();
+        // In coalescing mode sendReport() replaces the report still waiting for the host, so only
+        // the latest state is sent on each poll.
+        inline bool setCoalescing(bool coalesce) {
+            return coalesce ? setReportQueue(HID_QUEUE_KEEP_LATEST) : clearReportQueue();
+        }
+        inline bool getCoalescing() {
+            return queuePolicy == HID_QUEUE_KEEP_LATEST;
+        }
+        // wait until the reports in this report ID's queue have been sent (e.g., between press and release)
+        void flushReport();
+        // needs a report queue; the highest priority goes first, reports without a queue have priority 0
+        inline bool setPriority(uint8_t priority) {
+            return usb_hid_set_report_priority(instance, reportID, priority);
+        }
+        // needs a report queue
+        inline bool getStats(HIDReportStats* stats) {
+            return usb_hid_get_report_stats(instance, reportID, stats);
+        }
+        inline void clearStats() {
+            usb_hid_clear_report_stats(instance, reportID);
+        }
         
     public:
         // if you use this init function, the buffer starts with a reportID, even if the reportID is zero,
@@ -346,7 +605,16 @@ class HIDReporter {
         uint16_t getFeature(uint8_t* out=NULL, uint8_t poll=1);
         uint16_t getOutput(uint8_t* out=NULL, uint8_t poll=1);
         uint16_t getData(uint8_t type, uint8_t* out, uint8_t poll=1); // type = HID_REPORT_TYPE_FEATURE or HID_REPORT_TYPE_OUTPUT
-        void setFeature(uint8_t* feature);
+        // Returns false if the host is partway through a transfer of the report that needs the
+        // memory it goes to; give the feature buffer a backBuffer to make that rare
+        bool setFeature(const uint8_t* feature);
+        // see USBHIDDevice::setBufferCallback(); the buffer must have been added
+        inline bool setOutputCallback(HIDBufferCallback callback, void* context=NULL, bool deferred=false) {
+            return usb_hid_set_buffer_callback(instance, HID_REPORT_TYPE_OUTPUT, reportID, callback, context, deferred);
+        }
+        inline bool setFeatureCallback(HIDBufferCallback callback, void* context=NULL, bool deferred=false) {
+            return usb_hid_set_buffer_callback(instance, HID_REPORT_TYPE_FEATURE, reportID, callback, context, deferred);
+        }
 };
 
 //================================================================================
@@ -362,18 +630,43 @@ class HIDMouse : public HIDReporter {
 protected:
     uint8_t _buttons;
 	void buttons(uint8_t b);
-    uint8_t reportBuffer[5];
+    uint8_t reportBuffer[7];
+    // 1 for HID_MOUSE_REPORT_DESCRIPTOR, 2 for HID_MOUSE16_REPORT_DESCRIPTOR
+    uint8_t axisBytes;
+    // motion not yet reported in accumulating mode
+    volatile int32_t pendingX = 0;
+    volatile int32_t pendingY = 0;
+    volatile int32_t pendingWheel = 0;
+    volatile bool buttonsPending = false;
+    bool accumulating = false;
+    void fillReport(int32_t x, int32_t y, int32_t wheel);
+    void sendAccumulated(void);
+    static void accumulatedCallback(void* mouse);
+	HIDMouse(uint8_t reportID, uint8_t _axisBytes) : HIDReporter(reportBuffer, 3+2*_axisBytes, reportID), _buttons(0), axisBytes(_axisBytes) {}
 public:
-	HIDMouse(uint8_t reportID=HID_MOUSE_REPORT_ID) : HIDReporter(reportBuffer, sizeof(reportBuffer), reportID), _buttons(0) {}
+	HIDMouse(uint8_t reportID=HID_MOUSE_REPORT_ID) : HIDReporter(reportBuffer, 5, reportID), _buttons(0), axisBytes(1) {}
 	void begin(void);
 	void end(void);
 	void click(uint8_t b = MOUSE_LEFT);
-	void move(signed char x, signed char y, signed char wheel = 0);
+	// Values outside the report's range are clamped, unless accumulating.
+	void move(int32_t x, int32_t y, int32_t wheel = 0);
+	// In accumulating mode move() only adds to the motion still to be reported, and a
+	// report is made each time the host polls, with as much of it as fits; so a fast
+	// sensor neither fills the tx buffer nor needs to split large movements. Takes one
+	// of the interface's MAX_HID_TX_IDLE_CALLBACKS; stays off if they are all taken.
+	void setAccumulating(bool enable);
+	bool isMoving(void);
 	void press(uint8_t b = MOUSE_LEFT);		// press LEFT by default
 	void release(uint8_t b = MOUSE_LEFT);	// release LEFT by default
 	bool isPressed(uint8_t b = MOUSE_ALL);	// check all buttons by default
 };
 
+// Goes with HID_MOUSE16_REPORT_DESCRIPTOR
+class HIDMouse16 : public HIDMouse {
+public:
+	HIDMouse16(uint8_t reportID=HID_MOUSE_REPORT_ID) : HIDMouse(reportID, 2) {}
+};
+
 typedef struct {
     uint8_t reportID;
     uint8_t buttons;
@@ -402,6 +695,99 @@ public:
 	bool isPressed(uint8_t b = MOUSE_ALL);	// check all buttons by default
 };
 
+typedef struct {
+    uint8_t tip;
+    uint8_t id;
+    uint16_t x;
+    uint16_t y;
+} __packed DigitizerContact_t;
+
+/* Goes with HID_DIGITIZER_REPORT_DESCRIPTOR(contacts). touch() and release()
+ * update a table of contacts, and send() sends them all in one report, but
+ * only if one has changed. Each finger is known by an ID of the caller's
+ * choosing; X and Y go from 0 to 32767. A released finger is sent once with
+ * the tip switch off and then forgotten. */
+template<unsigned contacts=HID_DIGITIZER_CONTACTS>class HIDDigitizer : public HIDReporter {
+    static_assert(contacts >= 1 && contacts <= 10, "HID_DIGITIZER_REPORT_DESCRIPTOR has 1 to 10 contacts");
+private:
+    struct {
+        uint8_t reportID;
+        DigitizerContact_t contact[contacts];
+        uint8_t count;
+    } __packed report;
+    DigitizerContact_t table[contacts];
+    uint16_t dirty = 0; // bit i: table[i] has changed since the last report
+    uint8_t maxData[HID_BUFFER_ALLOCATE_SIZE(1,1)];
+    HIDBuffer_t maxBuffer;
+    int find(uint8_t id) {
+        for (unsigned i = 0; i < contacts; i++)
+            if ((table[i].tip || (dirty & (1 << i))) && table[i].id == id)
+                return i;
+        return -1;
+    }
+public:
+    HIDDigitizer(uint8_t reportID=HID_DIGITIZER_REPORT_ID) :
+        HIDReporter((uint8_t*)&report, sizeof(report), reportID),
+        maxBuffer(maxData, HID_BUFFER_SIZE(1,reportID), reportID, HID_BUFFER_MODE_NO_WAIT) {
+        memset(table, 0, sizeof(table));
+    }
+    void begin(void) {
+        uint8_t max = contacts;
+        usb_hid_add_buffer(getHIDInstance(), HID_REPORT_TYPE_FEATURE, &maxBuffer);
+        setFeature(&max);
+    }
+    void end(void) {}
+    // Puts finger id down at x, y, or moves it there. Returns false if contacts fingers are down already.
+    bool touch(uint8_t id, uint16_t x, uint16_t y) {
+        if (x > 32767) x = 32767;
+        if (y > 32767) y = 32767;
+        int i = find(id);
+        if (i < 0) {
+            for (i = 0; i < (int)contacts && (table[i].tip || (dirty & (1 << i))); i++)
+                ;
+            if (i == (int)contacts)
+                return false;
+            table[i].id = id;
+            table[i].tip = 0;
+        }
+        if (!table[i].tip || table[i].x != x || table[i].y != y) {
+            table[i].tip = 1;
+            table[i].x = x;
+            table[i].y = y;
+            dirty |= 1 << i;
+        }
+        return true;
+    }
+    void release(uint8_t id) {
+        int i = find(id);
+        if (i >= 0 && table[i].tip) {
+            table[i].tip = 0;
+            dirty |= 1 << i;
+        }
+    }
+    void releaseAll(void) {
+        for (unsigned i = 0; i < contacts; i++)
+            if (table[i].tip) {
+                table[i].tip = 0;
+                dirty |= 1 << i;
+            }
+    }
+    // Sends the fingers down and those just released. Returns false if nothing changed.
+    bool send(void) {
+        if (dirty == 0)
+            return false;
+        unsigned n = 0;
+        memset(report.contact, 0, sizeof(report.contact));
+        for (unsigned i = 0; i < contacts; i++)
+            if (table[i].tip || (dirty & (1 << i)))
+                report.contact[n++] = table[i];
+        report.count = n;
+        dirty = 0;
+        sendReport();
+        return true;
+    }
+};
+
 typedef struct {
     uint8_t reportID;
     uint16_t button;
@@ -483,6 +869,25 @@ protected:
     uint8_t reportID;
     uint8_t getKeyCode(uint8_t k, uint8_t* modifiersP);
     bool adjustForHostCapsLock = true;
+    // keys waiting for background typing, and the report it last sent
+    uint8_t typingQueue[HID_KEYBOARD_TYPING_QUEUE_SIZE];
+    volatile uint8_t typingHead = 0;
+    volatile uint8_t typingTail = 0;
+    KeyReport_t typingReport;
+    bool backgroundTyping = false;
+    static void typingCallback(void* keyboard);
+    void (*ledCallback)(uint8_t leds) = NULL;
+    uint8_t lastLEDs = 0;
+    static void ledsWritten(void* keyboard, const uint8* data, uint16 length);
+    void typeNext(void);
+    void addTypedKeys(KeyReport_t* report);
+    virtual bool sendTypingReport(void);
+    void sendKeyReport(void);
+    HIDKeyboard(uint8_t* report, unsigned size, uint8_t _reportID) :
+        HIDReporter(report, size, _reportID),
+        ledData(leds, HID_BUFFER_SIZE(1,_reportID), _reportID, HID_BUFFER_MODE_NO_WAIT),
+        reportID(_reportID)
+        {}
 
 public:
 	HIDKeyboard(uint8_t _reportID=HID_KEYBOARD_REPORT_ID) : 
@@ -495,9 +900,20 @@ public:
     void setAdjustForHostCapsLock(bool state) {
         adjustForHostCapsLock = state;
     }
-    inline uint8 getLEDs(void) {
+    virtual uint8 getLEDs(void) {
         return leds[reportID != 0 ? 1 : 0];
     }
+    // callback(leds) whenever the host changes the LEDs, so they need not be polled; call after
+    // begin(). If deferred, it is called from USBHIDDevice::runBufferCallbacks() rather than
+    // the USB interrupt.
+    bool setLEDCallback(void (*callback)(uint8_t leds), bool deferred=false);
+    // With background typing, write() (and so print()) only queues the keys, and they are
+    // typed from the USB interrupt, up to HID_KEYBOARD_ROLLOVER keys per report. Keys held
+    // with press() stay down meanwhile, and held modifiers apply to the typed keys as well.
+    // Call after setHID().
+    void setBackgroundTyping(bool enable);
+    bool queueKey(uint8_t k); // false if the queue is full
+    bool isTyping(void);
 	virtual size_t write(uint8_t k);
 	virtual size_t press(uint8_t k);
 	virtual size_t release(uint8_t k);
@@ -505,6 +921,38 @@ public:
 };
 
 
+typedef struct{
+    uint8_t reportID;
+	uint8_t modifiers;
+	uint8_t keys[HID_NKRO_KEYBOARD_KEYS/8];
+} __packed NKROKeyReport_t;
+
+/* Goes with HID_NKRO_KEYBOARD_REPORT_DESCRIPTOR. press() and release() set and
+ * clear the key's bit. If the interface is made a boot keyboard with
+ * USBHIDDevice::setInterfaceProtocol(HID_INTERFACE_PROTOCOL_KEYBOARD) and a
+ * BIOS selects the boot protocol, the first six keys down are sent in the
+ * boot layout instead. A boot keyboard interface should have no other
+ * reports, since the BIOS cannot tell them apart. */
+class HIDNKROKeyboard : public HIDKeyboard {
+protected:
+    NKROKeyReport_t nkroReport;
+    uint8_t bootLeds[HID_BUFFER_ALLOCATE_SIZE(1,0)];
+    HIDBuffer_t bootLedData;
+    void sendKeys(void);
+    void bootReport(KeyReport_t* boot);
+    virtual bool sendTypingReport(void);
+public:
+	HIDNKROKeyboard(uint8_t _reportID=HID_KEYBOARD_REPORT_ID) :
+        HIDKeyboard((uint8_t*)&nkroReport, sizeof(nkroReport), _reportID),
+        bootLedData(bootLeds, HID_BUFFER_SIZE(1,0), 0, HID_BUFFER_MODE_NO_WAIT)
+        {}
+	void begin(void);
+    virtual uint8 getLEDs(void);
+	virtual size_t press(uint8_t k);
+	virtual size_t release(uint8_t k);
+	virtual void releaseAll(void);
+};
+
 //================================================================================
 //================================================================================
 //	Joystick
@@ -573,13 +1021,223 @@ public:
         buf.buffer = rxBuffer;
         buf.bufferSize = HID_BUFFER_SIZE(rxSize,0);
         buf.reportID = 0;
-        USBHID.addOutputBuffer(&buf);
+        usb_hid_add_buffer(getHIDInstance(), HID_REPORT_TYPE_OUTPUT, &buf);
     }
 	void end(void);
 	void send(const uint8_t* data, unsigned n=sizeof(txBuffer)) {
+        // reports over a packet are streamed from txBuffer, which has to wait for the last one
+        while (sizeof(txBuffer) > USB_HID_TX_EPSIZE && sending())
+            ;
         memset(txBuffer, 0, sizeof(txBuffer));
         memcpy(txBuffer, data, n>sizeof(txBuffer)?sizeof(txBuffer):n);
-        sendReport();
+        if (sizeof(txBuffer) > USB_HID_TX_EPSIZE)
+            startSend(txBuffer);
+        else
+            sendReport();
+    }
+    // Sends txSize bytes of data in back-to-back packets without copying them. data must
+    // stay unchanged until sending() is false. Returns false if the last one is still going.
+    bool startSend(const uint8_t* data) {
+        return usb_hid_tx_stream(getHIDInstance(), data, txSize);
+    }
+    bool sending() {
+        return usb_hid_stream_busy(getHIDInstance());
+    }
+    // number of startSend() reports (and send() ones over a packet) the host has received
+    uint32_t getSentCount() {
+        return usb_hid_get_stream_completed(getHIDInstance());
+    }
+};
+
+/* A full speed interrupt endpoint moves at most one 64 byte packet per frame.
+ * HIDRawStream spreads a stream of reports over the endpoints of several HID
+ * interfaces (hosts only poll the first IN endpoint of an interface), taking
+ * turns and skipping an interface whose buffer is full. Each report starts
+ * with a 16-bit little-endian sequence number, so that the host can put them
+ * back in order (see scripts/hidstream.py). Each interface needs
+ * HID_RAW_STREAM_REPORT_DESCRIPTOR(reportSize), and a poll interval of 1.
+ * The library has to be built with USB_HID_MAX_INSTANCES of 2 or more. */
+template<unsigned reportSize=USB_HID_TX_EPSIZE>class HIDRawStream {
+private:
+    uint8_t report[reportSize];
+    uint8_t instances[USB_HID_MAX_INSTANCES];
+    uint8_t count = 0;
+    uint8_t next = 0;
+    uint16_t sequence = 0;
+public:
+    static const unsigned payloadSize = reportSize - 2;
+    void addHID(USBHIDDevice& device) {
+        if (count < USB_HID_MAX_INSTANCES)
+            instances[count++] = device.getInstance();
+    }
+    // Queues payloadSize bytes of data. Returns false if all interfaces are busy.
+    bool write(const uint8_t* data) {
+        report[0] = LSB(sequence);
+        report[1] = MSB(sequence);
+        memcpy(report+2, data, payloadSize);
+        for (unsigned i = 0; i < count; i++) {
+            uint8_t instance = instances[next];
+            next = next + 1 < count ? next + 1 : 0;
+            if (usb_hid_tx(instance, report, reportSize)) {
+                sequence++;
+                return true;
+            }
+        }
+        return false;
+    }
+    inline uint16_t getSequence() {
+        return sequence;
+    }
+};
+
+/* Gives the host access to a table of parameters (usually a struct) through
+ * the two feature reports of HID_REGISTER_MAP_REPORT_DESCRIPTOR(blockSize),
+ * instead of a feature buffer per parameter. The host writes the address and
+ * length (0 for blockSize) of a window into the table to the window report.
+ * Reading the data report then returns the window as it was when selected,
+ * padded with zeros, and writing it stores bytes in the window. So a
+ * whole table of up to blockSize bytes takes two transfers to read.
+ *
+ * Reading the window report returns the (clamped) window, the table size
+ * and a mask of the changes: the table is split into 32 segments of
+ * (size+31)/32 bytes, and bit i is set when the firmware has written
+ * segment i since the host last selected a window covering all of it.
+ * takeWritten() returns the same mask for the host's writes. Copies between
+ * the table and the reports run with the USB interrupt off, so neither side
+ * sees half an update, as long as the firmware uses write() and read(). */
+template<unsigned blockSize=HID_REGISTER_MAP_BLOCK_SIZE>class HIDRegisterMap {
+    static_assert(blockSize >= 1 && blockSize <= 65534, "a data report has 1 to 65534 bytes");
+private:
+    uint8_t* table;
+    uint16_t size;
+    uint16_t segmentSize;
+    uint8_t instance = 0;
+    uint8_t reportID;
+    HIDRegisterWindow_t window;
+    volatile uint32_t written = 0;
+    uint8_t windowData[HID_BUFFER_ALLOCATE_SIZE(sizeof(HIDRegisterWindow_t),1)];
+    uint8_t blockData[HID_BUFFER_ALLOCATE_SIZE(blockSize,1)];
+    HIDBuffer_t windowBuffer;
+    HIDBuffer_t blockBuffer;
+
+    static uint32_t bits(unsigned first, unsigned last) {
+        if (first > last)
+            return 0;
+        return (0xFFFFFFFFul >> (31 - last)) & ~((1ul << first) - 1);
+    }
+    // segments with a byte in address..address+length-1
+    uint32_t touching(unsigned address, unsigned length) {
+        if (length == 0)
+            return 0;
+        return bits(address / segmentSize, (address + length - 1) / segmentSize);
+    }
+    // segments all in address..address+length-1
+    uint32_t covering(unsigned address, unsigned length) {
+        unsigned end = address + length;
+        unsigned first = (address + segmentSize - 1) / segmentSize;
+        unsigned after = (end == size ? end + segmentSize - 1 : end) / segmentSize; // the last one may be short
+        return length == 0 || after == 0 ? 0 : bits(first, after - 1);
+    }
+    // the rest run with the USB interrupt off
+    void publishWindow() {
+        windowData[0] = reportID;
+        memcpy(windowData+1, &window, sizeof(window));
+    }
+    void snapshot() {
+        blockData[0] = reportID+1;
+        memcpy(blockData+1, table+window.address, window.length);
+        memset(blockData+1+window.length, 0, blockSize-window.length);
+    }
+    void select(unsigned address, unsigned length) {
+        if (address > size)
+            address = size;
+        if (length == 0 || length > blockSize)
+            length = blockSize;
+        if (length > size - address)
+            length = size - address;
+        window.address = address;
+        window.length = length;
+        snapshot();
+        window.changed &= ~covering(address, length);
+        publishWindow();
+    }
+    static void windowWritten(void* context, const uint8* data, uint16 length) {
+        HIDRegisterMap* map = (HIDRegisterMap*)context;
+        map->select(length >= 2 ? data[0] | (data[1] << 8) : 0, length >= 4 ? data[2] | (data[3] << 8) : 0);
+    }
+    static void blockWritten(void* context, const uint8* data, uint16 length) {
+        HIDRegisterMap* map = (HIDRegisterMap*)context;
+        if (length > map->window.length)
+            length = map->window.length;
+        memcpy(map->table+map->window.address, data, length);
+        map->written |= map->touching(map->window.address, length);
+        map->snapshot();
+    }
+public:
+    HIDRegisterMap(void* _table, uint16_t _size, uint8_t _reportID=HID_REGISTER_MAP_REPORT_ID) :
+        table((uint8_t*)_table), size(_size), segmentSize(_size > 32 ? (_size + 31) / 32 : 1), reportID(_reportID),
+        windowBuffer(windowData, HID_BUFFER_SIZE(sizeof(HIDRegisterWindow_t),_reportID), _reportID, HID_BUFFER_MODE_NO_WAIT),
+        blockBuffer(blockData, HID_BUFFER_SIZE(blockSize,_reportID+1), _reportID+1, HID_BUFFER_MODE_NO_WAIT) {
+        window.address = 0;
+        window.length = 0;
+        window.size = _size;
+        window.changed = 0;
+    }
+    // the reports go to USBHID unless set otherwise here
+    inline void setHID(USBHIDDevice& device) {
+        instance = device.getInstance();
+    }
+    void begin(void) {
+        windowBuffer.state = HID_BUFFER_READ;
+        windowBuffer.currentDataSize = windowBuffer.bufferSize;
+        blockBuffer.state = HID_BUFFER_READ;
+        blockBuffer.currentDataSize = blockBuffer.bufferSize;
+        usb_hid_add_buffer(instance, HID_REPORT_TYPE_FEATURE, &windowBuffer);
+        usb_hid_add_buffer(instance, HID_REPORT_TYPE_FEATURE, &blockBuffer);
+        usb_hid_lock();
+        select(0, blockSize);
+        usb_hid_unlock();
+        usb_hid_set_buffer_callback(instance, HID_REPORT_TYPE_FEATURE, reportID, windowWritten, this, false);
+        usb_hid_set_buffer_callback(instance, HID_REPORT_TYPE_FEATURE, reportID+1, blockWritten, this, false);
+    }
+    void end(void) {}
+    // Copies length bytes of data to the table at address, and flags them for the host. Returns false if out of range.
+    bool write(uint16_t address, const void* data, uint16_t length) {
+        if (address > size || length > size - address)
+            return false;
+        usb_hid_lock();
+        memcpy(table+address, data, length);
+        window.changed |= touching(address, length);
+        publishWindow();
+        usb_hid_unlock();
+        return true;
+    }
+    // Copies length bytes at address from the table, with no host write halfway through it
+    bool read(uint16_t address, void* out, uint16_t length) {
+        if (address > size || length > size - address)
+            return false;
+        usb_hid_lock();
+        memcpy(out, table+address, length);
+        usb_hid_unlock();
+        return true;
+    }
+    // for members of the table struct: map.set(offsetof(Settings, gain), gain)
+    template<class T> inline bool set(uint16_t address, const T& value) {
+        return write(address, &value, sizeof(T));
+    }
+    template<class T> inline bool get(uint16_t address, T& value) {
+        return read(address, &value, sizeof(T));
+    }
+    // Segments the host has written since the last call (see above); 0 if none
+    uint32_t takeWritten(void) {
+        usb_hid_lock();
+        uint32_t mask = written;
+        written = 0;
+        usb_hid_unlock();
+        return mask;
+    }
+    inline uint16_t getSegmentSize(void) {
+        return segmentSize;
     }
 };
 
@@ -595,6 +1253,9 @@ extern const HIDReportDescriptor* hidReportKeyboardMouse;
 extern const HIDReportDescriptor* hidReportKeyboardJoystick;
 extern const HIDReportDescriptor* hidReportKeyboardMouseJoystick;
 extern const HIDReportDescriptor* hidReportBootKeyboard;
+extern const HIDReportDescriptor* hidReportNKROKeyboard;
+extern const HIDReportDescriptor* hidReportMouse16;
+extern const HIDReportDescriptor* hidReportDigitizer;
 
 #define HID_MOUSE                   hidReportMouse
 #define HID_KEYBOARD                hidReportKeyboard
@@ -603,6 +1264,76 @@ extern const HIDReportDescriptor* hidReportBootKeyboard;
 #define HID_KEYBOARD_JOYSTICK       hidReportKeyboardJoystick
 #define HID_KEYBOARD_MOUSE_JOYSTICK hidReportKeyboardMouseJoystick
 #define HID_BOOT_KEYBOARD           hidReportBootKeyboard
+#define HID_NKRO_KEYBOARD           hidReportNKROKeyboard
+#define HID_MOUSE16                 hidReportMouse16
+#define HID_DIGITIZER               hidReportDigitizer
+
+//================================================================================
+//================================================================================
+//	Sequencer
+
+#define HID_ACTION_END              0
+#define HID_ACTION_WAIT             1  // value: milliseconds
+#define HID_ACTION_KEY_DOWN         2  // key: as for HIDKeyboard::press()
+#define HID_ACTION_KEY_UP           3
+#define HID_ACTION_KEY_TAP          4  // press, and release at a later tick
+#define HID_ACTION_CONSUMER_PRESS   5  // value: consumer usage
+#define HID_ACTION_CONSUMER_RELEASE 6
+#define HID_ACTION_MOUSE_MOVE       7  // value: x in the low byte, y in the high byte
+#define HID_ACTION_MOUSE_PRESS      8  // key: mouse buttons
+#define HID_ACTION_MOUSE_RELEASE    9
+#define HID_ACTION_MOUSE_SCROLL     10 // value: wheel
+
+typedef struct {
+    uint8_t type;
+    uint8_t key;
+    uint16_t value;
+} HIDAction;
+
+#define HID_MACRO_END                { HID_ACTION_END, 0, 0 }
+#define HID_MACRO_WAIT(ms)           { HID_ACTION_WAIT, 0, (ms) }
+#define HID_MACRO_KEY_DOWN(k)        { HID_ACTION_KEY_DOWN, (k), 0 }
+#define HID_MACRO_KEY_UP(k)          { HID_ACTION_KEY_UP, (k), 0 }
+#define HID_MACRO_KEY_TAP(k)         { HID_ACTION_KEY_TAP, (k), 0 }
+#define HID_MACRO_CONSUMER_PRESS(u)  { HID_ACTION_CONSUMER_PRESS, 0, (u) }
+#define HID_MACRO_CONSUMER_RELEASE   { HID_ACTION_CONSUMER_RELEASE, 0, 0 }
+#define HID_MACRO_MOUSE_MOVE(x, y)   { HID_ACTION_MOUSE_MOVE, 0, (uint16_t)((uint8_t)(x) | (uint8_t)(y) << 8) }
+#define HID_MACRO_MOUSE_PRESS(b)     { HID_ACTION_MOUSE_PRESS, (b), 0 }
+#define HID_MACRO_MOUSE_RELEASE(b)   { HID_ACTION_MOUSE_RELEASE, (b), 0 }
+#define HID_MACRO_MOUSE_SCROLL(w)    { HID_ACTION_MOUSE_SCROLL, 0, (uint8_t)(w) }
+
+/* Plays a const HIDAction array, ending with HID_MACRO_END, without blocking.
+ * tick() runs whatever is due; call it from loop() or from a timer interrupt.
+ * An action that sends a report waits until the reports before it have gone
+ * out, from the tx buffer and from its reporter's own queue (and, for an
+ * accumulating mouse, its motion), so tick() never blocks on a full buffer
+ * or replaces a coalesced report the host has not seen, and the reports of the other
+ * reporters on the interface are sent in between. For the same reason a tap
+ * sends the press, and the release at the first tick after the press has
+ * gone out. */
+class HIDSequencer {
+private:
+    HIDKeyboard* keyboard;
+    HIDMouse* mouse;
+    HIDConsumer* consumer;
+    const HIDAction* volatile next = NULL;
+    uint32_t wakeAt = 0;
+    volatile bool ticking = false;
+    bool tapping = false; // the key of the HID_ACTION_KEY_TAP at next is down
+    void (*doneCallback)(void) = NULL;
+    HIDReporter* reporterFor(uint8_t type);
+    bool busy(HIDReporter* reporter);
+public:
+    HIDSequencer(HIDKeyboard* _keyboard=&Keyboard, HIDMouse* _mouse=&Mouse, HIDConsumer* _consumer=NULL) :
+        keyboard(_keyboard), mouse(_mouse), consumer(_consumer) {}
+    // done is called (from tick()) after the last action
+    void start(const HIDAction* actions, void (*done)(void)=NULL);
+    void stop(void);
+    inline bool isRunning(void) {
+        return next != NULL;
+    }
+    void tick(void);
+};
 
 #endif
         		
\ No newline at end of file
@@ -42,6 +42,10 @@ void USBXBox360::setLEDCallback(void (*callback)(uint8 pattern)) {
     x360_set_led_callback(callback);
 }
 
+void USBXBox360::setPollInterval(uint8 txInterval, uint8 rxInterval) {
+    x360_set_poll_intervals(txInterval, rxInterval);
+}
+
 
 bool USBXBox360::init(void* ignore) {
 	(void)ignore;
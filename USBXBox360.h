@@ -50,6 +50,8 @@ public:
 	void hat(int16_t dir);
     void setLEDCallback(void (*callback)(uint8 pattern));
     void setRumbleCallback(void (*callback)(uint8 left, uint8 right));
+    // in ms; takes effect at the next begin()
+    void setPollInterval(uint8 txInterval, uint8 rxInterval = 8);
 };
 
 extern USBXBox360 XBox360;
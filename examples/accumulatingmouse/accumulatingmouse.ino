@@ -0,0 +1,24 @@
+#include <USBComposite.h>
+
+/*
+ * A 16-bit mouse fed at a much faster rate than the host polls it, as a
+ * high resolution sensor would. The movements add up between polls and go
+ * out as one report each time, so nothing queues up. Draws a circle.
+ */
+
+HIDMouse16 Mouse16;
+
+void setup(){
+  USBHID.begin(HID_MOUSE16);
+  Mouse16.setAccumulating(true);
+  delay(1000);
+}
+
+void loop(){
+  for (int i = 0; i < 2000; i++) {
+    float a = i * 2 * PI / 2000;
+    Mouse16.move(30 * cos(a), 30 * sin(a));
+    delayMicroseconds(500);
+  }
+  delay(2000);
+}
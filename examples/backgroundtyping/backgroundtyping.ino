@@ -0,0 +1,20 @@
+#include <USBComposite.h>
+
+/*
+ * Types a paragraph with background typing: print() returns as soon as the
+ * text is queued, and up to six keys go into each report.
+ */
+
+void setup(){
+  USBHID.begin(HID_KEYBOARD);
+  Keyboard.begin();
+  Keyboard.setBackgroundTyping(true);
+  delay(1000);
+}
+
+void loop(){
+  Keyboard.println("The quick brown fox jumps over the lazy dog. Pack my box with five dozen liquor jugs.");
+  while (Keyboard.isTyping())
+    ;
+  delay(5000);
+}
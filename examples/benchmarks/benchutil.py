@@ -0,0 +1,88 @@
+"""
+Shared helpers for the Linux host side of the benchmark sketches.
+
+Devices are located through sysfs by USB vendor/product id, so the tools work
+with any backend that makes the board show up as a normal Linux USB device.
+"""
+
+import glob
+import os
+import sys
+import time
+
+VENDOR_ID = 0x1EAF
+
+
+def usb_ids(sysdir):
+    """Walk up from a sysfs device directory to the USB device and return (vid, pid)."""
+    d = os.path.realpath(sysdir)
+    while d != "/":
+        try:
+            with open(os.path.join(d, "idVendor")) as f:
+                vid = int(f.read(), 16)
+            with open(os.path.join(d, "idProduct")) as f:
+                pid = int(f.read(), 16)
+            return vid, pid
+        except (IOError, OSError, ValueError):
+            d = os.path.dirname(d)
+    return None, None
+
+
+def find_device(pattern, vid, pid, node=lambda sysdir: "/dev/" + os.path.basename(sysdir)):
+    """Return the /dev node of the first sysfs entry matching pattern owned by vid:pid."""
+    for sysdir in sorted(glob.glob(pattern)):
+        if usb_ids(os.path.join(sysdir, "device")) == (vid, pid):
+            return node(sysdir)
+    sys.exit("no %s device for %04x:%04x found" % (pattern, vid, pid))
+
+
+def find_hidraw(vid, pid):
+    return find_device("/sys/class/hidraw/hidraw*", vid, pid)
+
+
+def find_tty(vid, pid):
+    return find_device("/sys/class/tty/ttyACM*", vid, pid)
+
+
+def find_block(vid, pid):
+    return find_device("/sys/block/sd*", vid, pid)
+
+
+def find_midi(vid, pid):
+    return find_device("/sys/class/sound/midiC*D*", vid, pid,
+                       lambda sysdir: "/dev/snd/" + os.path.basename(sysdir))
+
+
+def find_event(vid, pid):
+    return find_device("/sys/class/input/event*", vid, pid,
+                       lambda sysdir: "/dev/input/" + os.path.basename(sysdir))
+
+
+def percentile(sorted_values, p):
+    if not sorted_values:
+        return 0.0
+    k = (len(sorted_values) - 1) * p / 100.0
+    lo = int(k)
+    hi = min(lo + 1, len(sorted_values) - 1)
+    return sorted_values[lo] + (sorted_values[hi] - sorted_values[lo]) * (k - lo)
+
+
+def print_latency(name, samples):
+    """Print min/percentile/max of a list of durations in seconds, in microseconds."""
+    s = sorted(samples)
+    if not s:
+        print("%s: no samples" % name)
+        return
+    print("%s: n=%d min=%.0f p50=%.0f p90=%.0f p99=%.0f max=%.0f us" % (
+        name, len(s), s[0] * 1e6, percentile(s, 50) * 1e6, percentile(s, 90) * 1e6,
+        percentile(s, 99) * 1e6, s[-1] * 1e6))
+
+
+def print_rate(name, count, nbytes, seconds):
+    if seconds <= 0:
+        seconds = 1e-9
+    print("%s: %d transfers, %d bytes in %.3f s: %.1f /s, %.3f MB/s" % (
+        name, count, nbytes, seconds, count / seconds, nbytes / seconds / 1e6))
+
+
+now = time.monotonic
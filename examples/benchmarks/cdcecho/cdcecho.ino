@@ -0,0 +1,26 @@
+/*
+ * CDC bulk echo benchmark: everything received on the virtual serial port is
+ * sent straight back.  Run cdcecho.py on the host for MB/s and round-trip
+ * latency figures.
+ */
+
+#include <USBComposite.h>
+
+#define PRODUCT_ID 0x30
+
+uint8 buf[64];
+
+void setup() {
+  USBComposite.setProductId(PRODUCT_ID);
+  CompositeSerial.begin();
+}
+
+void loop() {
+  uint32 n = CompositeSerial.available();
+  if (n) {
+    if (n > sizeof(buf))
+      n = sizeof(buf);
+    n = CompositeSerial.read(buf, n);
+    CompositeSerial.write(buf, n);
+  }
+}
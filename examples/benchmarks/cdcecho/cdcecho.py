@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+"""
+Host side of the cdcecho benchmark (Linux).
+
+    python3 cdcecho.py                  # throughput, then latency
+    python3 cdcecho.py --bytes 4000000 --size 1 --count 2000
+"""
+
+import argparse
+import os
+import select
+import sys
+import termios
+import tty
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+import benchutil
+
+PRODUCT_ID = 0x30
+
+
+def read_exact(fd, n, timeout=2.0):
+    data = b""
+    while len(data) < n:
+        if not select.select([fd], [], [], timeout)[0]:
+            sys.exit("timeout after %d of %d bytes" % (len(data), n))
+        data += os.read(fd, n - len(data))
+    return data
+
+
+def throughput(fd, total, chunk):
+    pattern = bytes(i & 0xFF for i in range(total))
+    sent = received = 0
+    errors = 0
+    start = benchutil.now()
+    while received < total:
+        wlist = [fd] if sent < total and sent - received < 4096 else []
+        r, w, _ = select.select([fd], wlist, [], 2.0)
+        if not r and not w:
+            sys.exit("timeout after %d bytes echoed" % received)
+        if w:
+            sent += os.write(fd, pattern[sent:sent + chunk])
+        if r:
+            data = os.read(fd, 4096)
+            if data != pattern[received:received + len(data)]:
+                errors += 1
+            received += len(data)
+    elapsed = benchutil.now() - start
+    benchutil.print_rate("echo", total // chunk, total, elapsed)
+    if errors:
+        print("%d corrupted reads" % errors)
+
+
+def latency(fd, size, count):
+    samples = []
+    for i in range(count):
+        payload = bytes((i + j) & 0xFF for j in range(size))
+        t = benchutil.now()
+        os.write(fd, payload)
+        if read_exact(fd, size) != payload:
+            print("mismatch in round trip %d" % i)
+        samples.append(benchutil.now() - t)
+    benchutil.print_latency("round trip (%d bytes)" % size, samples)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--device", help="tty device (default: find by USB id)")
+    ap.add_argument("--pid", type=lambda x: int(x, 0), default=PRODUCT_ID)
+    ap.add_argument("--bytes", type=int, default=1000000, help="bytes to echo for the throughput test")
+    ap.add_argument("--chunk", type=int, default=512, help="write size for the throughput test")
+    ap.add_argument("--size", type=int, default=8, help="payload size for the latency test")
+    ap.add_argument("--count", type=int, default=1000, help="round trips for the latency test")
+    args = ap.parse_args()
+
+    path = args.device or benchutil.find_tty(benchutil.VENDOR_ID, args.pid)
+    fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+    tty.setraw(fd)
+    termios.tcflush(fd, termios.TCIOFLUSH)
+    print(path)
+    try:
+        if args.bytes:
+            throughput(fd, args.bytes, args.chunk)
+        if args.count:
+            latency(fd, args.size, args.count)
+    finally:
+        os.close(fd)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,39 @@
+/*
+ * Mass storage benchmark.  The drive has no backing store: reads return a
+ * pattern computed from the block number (its first four bytes hold the
+ * block number) and writes are discarded, so the numbers measure the USB and
+ * SCSI path rather than a storage medium.  Run massio.py on the host.
+ */
+
+#include <USBComposite.h>
+
+#define PRODUCT_ID 0x33
+#define DRIVE_SIZE (16ul*1024*1024)
+#define BLOCK_SIZE 512
+
+bool write(uint32_t memoryOffset, const uint8_t *writebuff, uint16_t transferLength) {
+  (void)memoryOffset;
+  (void)writebuff;
+  (void)transferLength;
+  return true;
+}
+
+bool read(uint32_t memoryOffset, uint8_t *readbuff, uint16_t transferLength) {
+  for (uint32_t i = 0; i < transferLength; i += BLOCK_SIZE) {
+    uint32_t block = (memoryOffset + i) / BLOCK_SIZE;
+    memset(readbuff + i, block & 0xFF, BLOCK_SIZE);
+    memcpy(readbuff + i, &block, sizeof(block));
+  }
+  return true;
+}
+
+void setup() {
+  USBComposite.setProductId(PRODUCT_ID);
+  MassStorage.setDrive(0, DRIVE_SIZE, read, write);
+  MassStorage.registerComponent();
+  USBComposite.begin();
+}
+
+void loop() {
+  MassStorage.loop();
+}
@@ -0,0 +1,100 @@
+#!/usr/bin/env python3
+"""
+Host side of the massio benchmark (Linux block device, usually needs root).
+
+Reads bypass the page cache with O_DIRECT.  Write tests only run with
+--write; the sketch discards the data, but they still write to whatever
+device is given with --device, so double-check it.
+
+    sudo python3 massio.py --mbytes 4 --count 500
+"""
+
+import argparse
+import mmap
+import os
+import random
+import struct
+import sys
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+import benchutil
+
+PRODUCT_ID = 0x33
+BLOCK_SIZE = 512
+
+
+def check(buf, offset, length):
+    bad = 0
+    for i in range(0, length, BLOCK_SIZE):
+        if struct.unpack_from("<I", buf, i)[0] != (offset + i) // BLOCK_SIZE:
+            bad += 1
+    return bad
+
+
+def sequential(fd, size, chunk, write):
+    buf = mmap.mmap(-1, chunk)
+    bad = 0
+    start = benchutil.now()
+    for offset in range(0, size, chunk):
+        if write:
+            os.pwritev(fd, [buf], offset)
+        else:
+            os.preadv(fd, [buf], offset)
+            bad += check(buf, offset, chunk)
+    elapsed = benchutil.now() - start
+    benchutil.print_rate("sequential %s" % ("write" if write else "read"), size // chunk, size, elapsed)
+    if bad:
+        print("%d blocks with a wrong pattern" % bad)
+
+
+def randomio(fd, disk, chunk, count, write):
+    buf = mmap.mmap(-1, chunk)
+    samples = []
+    bad = 0
+    start = benchutil.now()
+    for _ in range(count):
+        offset = random.randrange(disk // chunk) * chunk
+        t = benchutil.now()
+        if write:
+            os.pwritev(fd, [buf], offset)
+        else:
+            os.preadv(fd, [buf], offset)
+        samples.append(benchutil.now() - t)
+        if not write:
+            bad += check(buf, offset, chunk)
+    elapsed = benchutil.now() - start
+    name = "random %d byte %s" % (chunk, "write" if write else "read")
+    benchutil.print_rate(name, count, count * chunk, elapsed)
+    benchutil.print_latency(name, samples)
+    if bad:
+        print("%d blocks with a wrong pattern" % bad)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--device", help="block device (default: find by USB id)")
+    ap.add_argument("--pid", type=lambda x: int(x, 0), default=PRODUCT_ID)
+    ap.add_argument("--mbytes", type=int, default=4, help="size of the sequential tests")
+    ap.add_argument("--chunk", type=int, default=65536, help="sequential transfer size")
+    ap.add_argument("--random-size", type=int, default=4096, help="random transfer size")
+    ap.add_argument("--count", type=int, default=500, help="number of random transfers")
+    ap.add_argument("--write", action="store_true", help="also run the write tests")
+    args = ap.parse_args()
+
+    path = args.device or benchutil.find_block(benchutil.VENDOR_ID, args.pid)
+    fd = os.open(path, (os.O_RDWR if args.write else os.O_RDONLY) | os.O_DIRECT)
+    disk = os.lseek(fd, 0, os.SEEK_END)
+    print("%s: %d bytes" % (path, disk))
+    size = min(args.mbytes * 1024 * 1024, disk) // args.chunk * args.chunk
+    try:
+        sequential(fd, size, args.chunk, False)
+        randomio(fd, disk, args.random_size, args.count, False)
+        if args.write:
+            sequential(fd, size, args.chunk, True)
+            randomio(fd, disk, args.random_size, args.count, True)
+    finally:
+        os.close(fd)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,45 @@
+/*
+ * MIDI benchmark.  Control change 119 with a non-zero value starts a flood of
+ * control change 1 messages carrying a 7-bit sequence number; value 0 stops
+ * it.  Note on messages are echoed back for round-trip timing.  Run
+ * midiflood.py on the host.
+ */
+
+#include <USBComposite.h>
+#include <USBMIDI.h>
+
+#define PRODUCT_ID 0x32
+#define CONTROL_FLOOD 119
+
+class BenchMidi : public USBMidi {
+public:
+  bool flooding = false;
+  uint8 sequence = 0;
+
+  virtual void handleNoteOn(unsigned int channel, unsigned int note, unsigned int velocity) {
+    sendNoteOn(channel, note, velocity);
+  }
+
+  virtual void handleControlChange(unsigned int channel, unsigned int controller, unsigned int value) {
+    (void)channel;
+    if (controller == CONTROL_FLOOD) {
+      flooding = value != 0;
+      sequence = 0;
+    }
+  }
+};
+
+BenchMidi midi;
+
+void setup() {
+  USBComposite.setProductId(PRODUCT_ID);
+  midi.begin();
+}
+
+void loop() {
+  midi.poll();
+  if (midi.flooding) {
+    midi.sendControlChange(0, 1, midi.sequence);
+    midi.sequence = (midi.sequence + 1) & 0x7F;
+  }
+}
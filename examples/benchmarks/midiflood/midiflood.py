@@ -0,0 +1,115 @@
+#!/usr/bin/env python3
+"""
+Host side of the midiflood benchmark (Linux ALSA raw MIDI).
+
+    python3 midiflood.py --seconds 5 --count 1000
+"""
+
+import argparse
+import os
+import select
+import sys
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+import benchutil
+
+PRODUCT_ID = 0x32
+CONTROL_FLOOD = 119
+
+
+class Parser(object):
+    """Splits a raw MIDI byte stream into channel messages, honouring running status."""
+
+    def __init__(self):
+        self.status = None
+        self.data = []
+
+    def feed(self, chunk):
+        messages = []
+        for b in bytearray(chunk):
+            if b >= 0xF8:
+                continue
+            if b & 0x80:
+                self.status, self.data = b, []
+                continue
+            if self.status is None:
+                continue
+            self.data.append(b)
+            need = 1 if (self.status & 0xF0) in (0xC0, 0xD0) else 2
+            if len(self.data) == need:
+                messages.append((self.status,) + tuple(self.data))
+                self.data = []
+        return messages
+
+
+def drain(fd):
+    while select.select([fd], [], [], 0.2)[0]:
+        os.read(fd, 4096)
+
+
+def flood(fd, seconds):
+    parser = Parser()
+    os.write(fd, bytes([0xB0, CONTROL_FLOOD, 127]))
+    count = gaps = 0
+    expected = None
+    start = benchutil.now()
+    while benchutil.now() - start < seconds:
+        if not select.select([fd], [], [], 1.0)[0]:
+            sys.exit("no flood data received")
+        for msg in parser.feed(os.read(fd, 4096)):
+            if msg[0] != 0xB0 or msg[1] != 1:
+                continue
+            if expected is not None and msg[2] != expected:
+                gaps += 1
+            expected = (msg[2] + 1) & 0x7F
+            count += 1
+    elapsed = benchutil.now() - start
+    os.write(fd, bytes([0xB0, CONTROL_FLOOD, 0]))
+    drain(fd)
+    # each message is one 4-byte USB-MIDI event on the wire
+    benchutil.print_rate("flood", count, count * 4, elapsed)
+    if gaps:
+        print("%d sequence gaps" % gaps)
+
+
+def latency(fd, count):
+    parser = Parser()
+    samples = []
+    for i in range(count):
+        note = 36 + i % 48
+        velocity = 1 + i % 127
+        t = benchutil.now()
+        os.write(fd, bytes([0x90, note, velocity]))
+        while True:
+            if not select.select([fd], [], [], 1.0)[0]:
+                print("note %d lost" % i)
+                break
+            if (0x90, note, velocity) in parser.feed(os.read(fd, 4096)):
+                samples.append(benchutil.now() - t)
+                break
+    benchutil.print_latency("note on round trip", samples)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--device", help="raw MIDI device (default: find by USB id)")
+    ap.add_argument("--pid", type=lambda x: int(x, 0), default=PRODUCT_ID)
+    ap.add_argument("--seconds", type=float, default=5.0, help="length of the flood test")
+    ap.add_argument("--count", type=int, default=500, help="round trips for the latency test")
+    args = ap.parse_args()
+
+    path = args.device or benchutil.find_midi(benchutil.VENDOR_ID, args.pid)
+    fd = os.open(path, os.O_RDWR)
+    print(path)
+    try:
+        drain(fd)
+        if args.seconds:
+            flood(fd, args.seconds)
+        if args.count:
+            latency(fd, args.count)
+    finally:
+        os.close(fd)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,27 @@
+/*
+ * Raw HID ping-pong benchmark: every 64-byte output report is returned as an
+ * input report.  Run rawhidpingpong.py on the host for reports/s and
+ * round-trip latency.
+ */
+
+#include <USBComposite.h>
+
+#define PRODUCT_ID 0x31
+#define REPORT_SIZE 64
+
+HIDRaw<REPORT_SIZE,REPORT_SIZE> raw;
+uint8 buf[REPORT_SIZE];
+
+const uint8_t reportDescription[] = {
+   HID_RAW_REPORT_DESCRIPTOR(REPORT_SIZE,REPORT_SIZE)
+};
+
+void setup() {
+  USBHID.begin(reportDescription, sizeof(reportDescription), 0, PRODUCT_ID);
+  raw.begin();
+}
+
+void loop() {
+  if (raw.getOutput(buf))
+    raw.send(buf, REPORT_SIZE);
+}
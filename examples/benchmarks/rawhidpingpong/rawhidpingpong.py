@@ -0,0 +1,58 @@
+#!/usr/bin/env python3
+"""
+Host side of the rawhidpingpong benchmark (Linux hidraw).
+
+    python3 rawhidpingpong.py --count 5000
+"""
+
+import argparse
+import os
+import select
+import struct
+import sys
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+import benchutil
+
+PRODUCT_ID = 0x31
+REPORT_SIZE = 64
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--device", help="hidraw device (default: find by USB id)")
+    ap.add_argument("--pid", type=lambda x: int(x, 0), default=PRODUCT_ID)
+    ap.add_argument("--count", type=int, default=2000, help="number of round trips")
+    args = ap.parse_args()
+
+    path = args.device or benchutil.find_hidraw(benchutil.VENDOR_ID, args.pid)
+    fd = os.open(path, os.O_RDWR)
+    print(path)
+
+    samples = []
+    lost = 0
+    start = benchutil.now()
+    for seq in range(args.count):
+        payload = struct.pack("<I", seq) + bytes((seq + i) & 0xFF for i in range(REPORT_SIZE - 4))
+        t = benchutil.now()
+        # no report IDs in the descriptor, so hidraw wants a leading zero
+        os.write(fd, b"\x00" + payload)
+        while True:
+            if not select.select([fd], [], [], 1.0)[0]:
+                lost += 1
+                break
+            data = os.read(fd, REPORT_SIZE)
+            if data[:4] == payload[:4]:
+                samples.append(benchutil.now() - t)
+                break
+    elapsed = benchutil.now() - start
+    os.close(fd)
+
+    benchutil.print_rate("ping-pong", len(samples), len(samples) * REPORT_SIZE * 2, elapsed)
+    benchutil.print_latency("round trip", samples)
+    if lost:
+        print("%d reports lost" % lost)
+
+
+if __name__ == "__main__":
+    main()
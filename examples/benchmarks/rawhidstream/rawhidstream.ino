@@ -0,0 +1,39 @@
+/*
+ * Raw HID streaming benchmark: 4 KB input reports are sent back to back
+ * straight from two alternating buffers, each starting with a sequence number
+ * and the number of output bytes received so far.  4 KB output reports come
+ * in through the interrupt OUT endpoint.  Run rawhidstream.py on the host.
+ */
+
+#include <USBComposite.h>
+
+#define PRODUCT_ID 0x34
+#define REPORT_SIZE 4096
+
+HIDRaw<REPORT_SIZE,REPORT_SIZE> raw;
+uint8 out[REPORT_SIZE];
+uint8 in[2][REPORT_SIZE];
+uint32 seq = 0;
+uint32 received = 0;
+
+const uint8_t reportDescription[] = {
+   HID_RAW_REPORT_DESCRIPTOR(REPORT_SIZE,REPORT_SIZE)
+};
+
+void setup() {
+  USBHID.setOutEndpoint(true);
+  USBHID.begin(reportDescription, sizeof(reportDescription), 0, PRODUCT_ID);
+  raw.begin();
+}
+
+void loop() {
+  if (raw.getOutput(out))
+    received += REPORT_SIZE;
+  // fill one buffer while the other one is being sent
+  uint8* buf = in[seq & 1];
+  memcpy(buf, &seq, 4);
+  memcpy(buf+4, &received, 4);
+  while (!raw.startSend(buf))
+    ;
+  seq++;
+}
@@ -0,0 +1,65 @@
+#!/usr/bin/env python3
+"""
+Host side of the rawhidstream benchmark (Linux hidraw).
+
+    python3 rawhidstream.py --seconds 5 --write 100
+"""
+
+import argparse
+import os
+import struct
+import sys
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+import benchutil
+
+PRODUCT_ID = 0x34
+REPORT_SIZE = 4096
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--device", help="hidraw device (default: find by USB id)")
+    ap.add_argument("--pid", type=lambda x: int(x, 0), default=PRODUCT_ID)
+    ap.add_argument("--seconds", type=float, default=5.0)
+    ap.add_argument("--write", type=int, default=0, help="output reports to send first")
+    args = ap.parse_args()
+
+    path = args.device or benchutil.find_hidraw(benchutil.VENDOR_ID, args.pid)
+    fd = os.open(path, os.O_RDWR)
+    print(path)
+
+    if args.write:
+        start = benchutil.now()
+        for i in range(args.write):
+            # no report IDs in the descriptor, so hidraw wants a leading zero
+            os.write(fd, b"\x00" + bytes((i + j) & 0xFF for j in range(REPORT_SIZE)))
+        benchutil.print_rate("output", args.write, args.write * REPORT_SIZE, benchutil.now() - start)
+
+    count = 0
+    skipped = 0
+    last = None
+    received = 0
+    start = benchutil.now()
+    while benchutil.now() - start < args.seconds:
+        data = os.read(fd, REPORT_SIZE)
+        if len(data) != REPORT_SIZE:
+            print("short report: %d bytes" % len(data))
+            continue
+        seq, received = struct.unpack("<II", data[:8])
+        if last is not None and seq != (last + 1) & 0xFFFFFFFF:
+            skipped += 1
+        last = seq
+        count += 1
+    elapsed = benchutil.now() - start
+    os.close(fd)
+
+    benchutil.print_rate("input", count, count * REPORT_SIZE, elapsed)
+    if skipped:
+        print("%d gaps in the sequence numbers" % skipped)
+    if args.write:
+        print("device received %d of %d output bytes" % (received, args.write * REPORT_SIZE))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,19 @@
+/*
+ * XBox 360 controller report rate benchmark.  Reports are sent back to back
+ * with a counter in the left stick X axis so the host can spot skipped
+ * reports.  Run x360rate.py on the host.
+ */
+
+#include <USBComposite.h>
+
+int16_t counter = 0;
+
+void setup() {
+  XBox360.setManualReportMode(true);
+  XBox360.begin();
+}
+
+void loop() {
+  XBox360.X(counter++);
+  XBox360.send();
+}
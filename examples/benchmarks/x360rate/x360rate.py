@@ -0,0 +1,68 @@
+#!/usr/bin/env python3
+"""
+Host side of the x360rate benchmark (Linux xpad driver, evdev).
+
+    python3 x360rate.py --seconds 5
+"""
+
+import argparse
+import os
+import select
+import struct
+import sys
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+import benchutil
+
+VENDOR_ID = 0x045E
+PRODUCT_ID = 0x028E
+
+EVENT = struct.Struct("llHHi")
+EV_SYN = 0
+EV_ABS = 3
+ABS_X = 0
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--device", help="event device (default: find by USB id)")
+    ap.add_argument("--seconds", type=float, default=5.0)
+    args = ap.parse_args()
+
+    path = args.device or benchutil.find_event(VENDOR_ID, PRODUCT_ID)
+    fd = os.open(path, os.O_RDONLY)
+    print(path)
+
+    reports = skipped = 0
+    last_x = None
+    last_time = None
+    intervals = []
+    start = benchutil.now()
+    while benchutil.now() - start < args.seconds:
+        if not select.select([fd], [], [], 1.0)[0]:
+            sys.exit("no reports received")
+        data = os.read(fd, EVENT.size * 64)
+        for off in range(0, len(data) - EVENT.size + 1, EVENT.size):
+            sec, usec, type_, code, value = EVENT.unpack_from(data, off)
+            if type_ == EV_ABS and code == ABS_X:
+                # xpad passes X through unchanged, so consecutive values differ by one
+                if last_x is not None and value != ((last_x + 1 + 32768) & 0xFFFF) - 32768:
+                    skipped += 1
+                last_x = value
+            elif type_ == EV_SYN and code == 0:
+                t = sec + usec * 1e-6
+                if last_time is not None:
+                    intervals.append(t - last_time)
+                last_time = t
+                reports += 1
+    elapsed = benchutil.now() - start
+    os.close(fd)
+
+    benchutil.print_rate("reports", reports, reports * 20, elapsed)
+    benchutil.print_latency("report interval", intervals)
+    if skipped:
+        print("%d discontinuities in the X axis counter" % skipped)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,49 @@
+#include <USBComposite.h>
+
+/*
+ * Publishes telemetry in a feature report as fast as loop() runs. The
+ * report is bigger than a packet, so the host reads it in two, but the
+ * feature buffer has a back buffer: each update goes there and then swaps
+ * with the one the host reads from, so the host never gets half of one
+ * update and half of the next. Read it with HIDIOCGFEATURE on Linux or
+ * HidD_GetFeature on Windows.
+ */
+
+#define TELEMETRY_REPORT_ID 5
+#define SAMPLES 32
+
+typedef struct {
+  uint32_t counter;
+  uint32_t micros;
+  uint16_t samples[SAMPLES];
+} __packed Telemetry_t;
+
+uint8_t front[HID_BUFFER_ALLOCATE_SIZE(sizeof(Telemetry_t),1)];
+uint8_t back[HID_BUFFER_ALLOCATE_SIZE(sizeof(Telemetry_t),1)];
+HIDBuffer_t telemetryBuffer(front, HID_BUFFER_SIZE(sizeof(Telemetry_t),1), TELEMETRY_REPORT_ID, HID_BUFFER_MODE_NO_WAIT, back);
+
+Telemetry_t telemetry;
+
+const uint8_t reportDescription[] = {
+  0x06, 0x00, 0xFF,    /* USAGE_PAGE (Vendor Defined Page 1) */
+  0x09, 0x01,          /* USAGE (Vendor Usage 1) */
+  0xA1, 0x01,          /* COLLECTION (Application) */
+  0x85, TELEMETRY_REPORT_ID, /* REPORT_ID */
+  HID_FEATURE_REPORT_DESCRIPTOR(sizeof(Telemetry_t))
+  0xC0                 /* END_COLLECTION */
+};
+
+void setup() {
+  pinMode(PA0, INPUT_ANALOG);
+  USBHID.begin(reportDescription, sizeof(reportDescription));
+  USBHID.addFeatureBuffer(&telemetryBuffer);
+}
+
+void loop() {
+  for (int i = 0; i < SAMPLES; i++)
+    telemetry.samples[i] = analogRead(PA0);
+  telemetry.counter++;
+  telemetry.micros = micros();
+  // false if the host was still reading the other buffer; the next update goes out instead
+  USBHID.setFeature(TELEMETRY_REPORT_ID, (uint8_t*)&telemetry);
+}
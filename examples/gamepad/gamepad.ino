@@ -0,0 +1,29 @@
+#include <USBComposite.h>
+#include <HIDReportBuilder.h>
+
+/*
+ * A flight controller with eight 16-bit axes, 128 buttons and four hat
+ * switches. All of them are updated together and go out in one report.
+ */
+
+HIDGamepad<8, 16, 128, 4> Gamepad;
+
+uint16_t axes[8];
+
+void setup(){
+  USBHID.begin(decltype(Gamepad)::Descriptor::data, decltype(Gamepad)::Descriptor::size);
+  Gamepad.begin();
+  delay(1000);
+}
+
+void loop(){
+  uint32_t t = millis();
+  for (unsigned i = 0; i < 8; i++)
+    axes[i] = t * (i + 1) * 16;
+  Gamepad.setAxes(axes);
+  Gamepad.setButtons(1ul << (t / 100 % 32), 1 + 32 * (t / 3200 % 4));
+  for (unsigned i = 0; i < 4; i++)
+    Gamepad.hat(i, t / 1000 % 8 * 45);
+  Gamepad.send();
+  delay(10);
+}
@@ -0,0 +1,46 @@
+#include <USBComposite.h>
+
+/*
+ * Streams 62 byte samples over the endpoints of two HID interfaces, for up
+ * to twice the rate of a single interrupt endpoint. On Linux,
+ *   python3 scripts/hidstream.py --pid 0x35
+ * reads them back in order.
+ *
+ * Build with -DUSB_HID_MAX_INSTANCES=2 (e.g., in the board's build flags), so
+ * that the library has room for the second interface.
+ */
+
+#if USB_HID_MAX_INSTANCES < 2
+#error "Define USB_HID_MAX_INSTANCES as 2 or more in the build flags"
+#endif
+
+#define PRODUCT_ID 0x35
+
+USBHIDDevice USBHID2(1);
+HIDRawStream<> stream;
+uint8 sample[stream.payloadSize];
+uint32 counter = 0;
+
+const uint8_t reportDescription[] = {
+   HID_RAW_STREAM_REPORT_DESCRIPTOR(USB_HID_TX_EPSIZE)
+};
+
+void setup(){
+  USBComposite.clear();
+  USBComposite.setProductId(PRODUCT_ID);
+  USBHID.setReportDescriptor(reportDescription, sizeof(reportDescription));
+  USBHID.setPollInterval(1);
+  USBHID.registerComponent();
+  USBHID2.setReportDescriptor(reportDescription, sizeof(reportDescription));
+  USBHID2.setPollInterval(1);
+  USBHID2.registerComponent();
+  stream.addHID(USBHID);
+  stream.addHID(USBHID2);
+  USBComposite.begin();
+}
+
+void loop(){
+  memcpy(sample, &counter, sizeof(counter));
+  if (stream.write(sample))
+    counter++;
+}
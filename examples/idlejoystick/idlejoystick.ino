@@ -0,0 +1,20 @@
+#include <USBComposite.h>
+
+/*
+ * A joystick read from a potentiometer on PA0 as fast as loop() runs. Its
+ * report queue drops reports that have not changed, so the host only hears
+ * about movements, plus a repeat at the idle rate if the host has set one
+ * with SET_IDLE. The host can also read the current state with
+ * GET_REPORT(Input).
+ */
+
+void setup() {
+  pinMode(PA0, INPUT_ANALOG);
+  Joystick.setReportQueue(HID_QUEUE_DROP_DUPLICATE);
+  USBHID.begin(HID_JOYSTICK);
+}
+
+void loop() {
+  Joystick.X(analogRead(PA0) >> 2);
+  USBHID.sendIdleReports();
+}
@@ -0,0 +1,24 @@
+#include <USBComposite.h>
+
+/*
+ * Lights the built-in LED with Caps Lock. The keyboard calls back when the
+ * host changes its LEDs, so they are not polled. The callback is deferred to
+ * runBufferCallbacks(), so it can print.
+ */
+
+void ledsChanged(uint8_t leds) {
+  digitalWrite(LED_BUILTIN, leds & 0x02 ? LOW : HIGH);
+  CompositeSerial.print("LEDs: ");
+  CompositeSerial.println(leds);
+}
+
+void setup() {
+  pinMode(LED_BUILTIN, OUTPUT);
+  USBHID_begin_with_serial(HID_KEYBOARD);
+  Keyboard.begin();
+  Keyboard.setLEDCallback(ledsChanged, true);
+}
+
+void loop() {
+  USBHID.runBufferCallbacks();
+}
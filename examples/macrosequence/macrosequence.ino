@@ -0,0 +1,64 @@
+#include <USBComposite.h>
+
+/*
+ * Plays a macro from flash when the button on PA0 is pressed: Ctrl held for
+ * a moment around a select-all and copy, a volume tap, then a mouse nudge
+ * and click. A hardware timer runs the sequencer, so loop() never waits.
+ */
+
+const HIDAction copyAll[] = {
+  HID_MACRO_KEY_DOWN(KEY_LEFT_CTRL),
+  HID_MACRO_WAIT(50),
+  HID_MACRO_KEY_TAP('a'),
+  HID_MACRO_KEY_TAP('c'),
+  HID_MACRO_WAIT(50),
+  HID_MACRO_KEY_UP(KEY_LEFT_CTRL),
+  HID_MACRO_CONSUMER_PRESS(HIDConsumer::VOLUME_UP),
+  HID_MACRO_WAIT(20),
+  HID_MACRO_CONSUMER_RELEASE,
+  HID_MACRO_MOUSE_MOVE(20, -10),
+  HID_MACRO_WAIT(100),
+  HID_MACRO_MOUSE_PRESS(MOUSE_LEFT),
+  HID_MACRO_WAIT(30),
+  HID_MACRO_MOUSE_RELEASE(MOUSE_LEFT),
+  HID_MACRO_END
+};
+
+const uint8_t reportDescription[] = {
+   HID_MOUSE_REPORT_DESCRIPTOR(),
+   HID_KEYBOARD_REPORT_DESCRIPTOR(),
+   HID_CONSUMER_REPORT_DESCRIPTOR()
+};
+
+HIDConsumer Consumer;
+HIDSequencer sequencer(&Keyboard, &Mouse, &Consumer);
+volatile bool done = true;
+
+void tick() {
+  sequencer.tick();
+}
+
+void finished() {
+  done = true;
+}
+
+void setup(){
+  pinMode(PA0, INPUT);
+  USBHID.begin(reportDescription, sizeof(reportDescription));
+  Keyboard.begin();
+
+  Timer2.pause();
+  Timer2.setPeriod(1000); // 1 ms
+  Timer2.setChannel1Mode(TIMER_OUTPUT_COMPARE);
+  Timer2.setCompare(TIMER_CH1, 1);
+  Timer2.attachCompare1Interrupt(tick);
+  Timer2.refresh();
+  Timer2.resume();
+}
+
+void loop(){
+  if (done && digitalRead(PA0)) {
+    done = false;
+    sequencer.start(copyAll, finished);
+  }
+}
@@ -0,0 +1,23 @@
+#include <USBComposite.h>
+
+/*
+ * An N-key rollover keyboard that is also a boot keyboard, so it works in a
+ * BIOS too. Holds down ten keys at once, which a six key report cannot.
+ */
+
+HIDNKROKeyboard NKROKeyboard;
+
+void setup(){
+  USBHID.setInterfaceProtocol(HID_INTERFACE_PROTOCOL_KEYBOARD);
+  USBHID.begin(HID_NKRO_KEYBOARD);
+  NKROKeyboard.begin();
+  delay(1000);
+}
+
+void loop(){
+  for (char c = '0'; c <= '9'; c++)
+    NKROKeyboard.press(c);
+  delay(100);
+  NKROKeyboard.releaseAll();
+  delay(5000);
+}
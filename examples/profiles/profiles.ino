@@ -0,0 +1,67 @@
+#include <USBComposite.h>
+
+/*
+ * Switches between keyboard + serial and mass storage + serial without
+ * rebuilding descriptors. Send 'm' over serial to switch to mass storage,
+ * 'k' to go back, and 't' to print how long the last switch took.
+ */
+
+#define DISK_SIZE 16384
+
+uint8 disk[DISK_SIZE];
+
+// Buffers of whichever profile is active. Storage + serial is the larger one:
+// 512 + 64 bytes for mass storage and 256 + 256 for the serial rings.
+uint32 arena[(512 + 64 + 256 + 256) / 4];
+
+USBCompositeProfile keyboardProfile("keyboard");
+USBCompositeProfile storageProfile("storage");
+
+bool write(uint32_t memoryOffset, const uint8_t *writebuff, uint16_t transferLength) {
+  memcpy(disk+memoryOffset, writebuff, transferLength);
+  return true;
+}
+
+bool read(uint32_t memoryOffset, uint8_t *readbuff, uint16_t transferLength) {
+  memcpy(readbuff, disk+memoryOffset, transferLength);
+  return true;
+}
+
+void setup() {
+  USBComposite.setArena(arena, sizeof(arena));
+
+  USBHID.setReportDescriptor(HID_KEYBOARD);
+  USBComposite.clear();
+  USBHID.registerComponent();
+  CompositeSerial.registerComponent();
+  USBComposite.saveProfile(keyboardProfile);
+
+  MassStorage.setDrive(0, sizeof(disk), read, write);
+  USBComposite.clear();
+  MassStorage.registerComponent();
+  CompositeSerial.registerComponent();
+  USBComposite.saveProfile(storageProfile);
+
+  USBComposite.switchProfile(keyboardProfile);
+}
+
+void loop() {
+  if (USBComposite.getProfile() == &storageProfile)
+    MassStorage.loop();
+  if (CompositeSerial.available()) {
+    switch (CompositeSerial.read()) {
+    case 'm':
+      USBComposite.switchProfile(storageProfile);
+      break;
+    case 'k':
+      USBComposite.switchProfile(keyboardProfile);
+      break;
+    case 't':
+      CompositeSerial.print(USBComposite.getProfile()->getName());
+      CompositeSerial.print(": ");
+      CompositeSerial.print(USBComposite.getSwitchTime());
+      CompositeSerial.println(" us");
+      break;
+    }
+  }
+}
@@ -11,6 +11,7 @@ const uint8_t reportDescription[] = {
 };
 
 void setup(){
+  USBHID.setOutEndpoint(true); // output reports through an interrupt endpoint instead of the control endpoint
   USBHID_begin_with_serial(reportDescription, sizeof(reportDescription));  
   raw.begin();
 }
@@ -0,0 +1,39 @@
+#include <USBComposite.h>
+#include <stddef.h>
+
+/*
+ * Lets a host tool read and change a table of settings through two feature
+ * reports (see scripts/hidregisters.py). The table fits in one data report,
+ * so the tool reads all of it with one window write and one data read. The
+ * sketch publishes a counter and the blink period, and takes a new period
+ * from the host.
+ */
+
+struct Settings {
+  uint32_t uptime;      // ms, read by the host
+  uint16_t blinkPeriod; // ms, set by the host
+  uint8_t  name[16];
+  int16_t  gains[8];
+} settings = { 0, 500, "registermap", { 0 } };
+
+uint16_t blinkPeriod = settings.blinkPeriod;
+
+HIDRegisterMap<sizeof(Settings)> registers(&settings, sizeof(settings));
+
+const uint8_t reportDescription[] = {
+   HID_REGISTER_MAP_REPORT_DESCRIPTOR(sizeof(Settings))
+};
+
+void setup() {
+  pinMode(LED_BUILTIN, OUTPUT);
+  USBHID.begin(reportDescription, sizeof(reportDescription));
+  registers.begin();
+}
+
+void loop() {
+  registers.set(offsetof(Settings, uptime), (uint32_t)millis());
+  if (registers.takeWritten())
+    registers.get(offsetof(Settings, blinkPeriod), blinkPeriod);
+  digitalWrite(LED_BUILTIN, millis() / (blinkPeriod ? blinkPeriod : 1) % 2);
+  delay(10);
+}
@@ -0,0 +1,32 @@
+#include <USBComposite.h>
+
+/*
+ * Prints the enumeration timeline (microseconds since boot) over the serial
+ * port whenever 't' is received.
+ */
+
+const char* eventNames[] = { "enable", "attached", "addressed", "configured", "request" };
+
+void setup() {
+  USBComposite.setFastAttach(true);
+  USBHID_begin_with_serial(HID_KEYBOARD_MOUSE);
+}
+
+void loop() {
+  if (CompositeSerial.available() && 't' == CompositeSerial.read()) {
+    const USBTimelineEvent* events;
+    uint32 n = USBComposite.getTimeline(&events);
+    for (uint32 i = 0; i < n; i++) {
+      CompositeSerial.print(events[i].micros - events[0].micros);
+      CompositeSerial.print(" us ");
+      CompositeSerial.print(eventNames[events[i].event]);
+      if (events[i].event == USB_TIMELINE_REQUEST) {
+        CompositeSerial.print(" bRequest=");
+        CompositeSerial.print(events[i].request);
+        CompositeSerial.print(" wValue=0x");
+        CompositeSerial.print(events[i].value, HEX);
+      }
+      CompositeSerial.println();
+    }
+  }
+}
@@ -0,0 +1,26 @@
+#include <USBComposite.h>
+
+/*
+ * A ten finger touch screen. Two fingers spread apart from the middle of the
+ * screen, as in a pinch zoom; each step is one report with both of them.
+ */
+
+HIDDigitizer<> Touch;
+
+void setup(){
+  USBHID.begin(HID_DIGITIZER);
+  Touch.begin();
+  delay(1000);
+}
+
+void loop(){
+  for (uint16_t d = 0; d < 8000; d += 200) {
+    Touch.touch(0, 16384 - d, 16384);
+    Touch.touch(1, 16384 + d, 16384);
+    Touch.send();
+    delay(10);
+  }
+  Touch.releaseAll();
+  Touch.send();
+  delay(3000);
+}
@@ -0,0 +1,38 @@
+#include <USBComposite.h>
+
+/*
+ * The keyboard and the joystick each get an HID interface with its own
+ * endpoint, so the joystick streaming at full rate does not delay key
+ * presses.
+ *
+ * Build with -DUSB_HID_MAX_INSTANCES=2 (e.g., in the board's build flags), so
+ * that the library has room for the second interface.
+ */
+
+#if USB_HID_MAX_INSTANCES < 2
+#error "Define USB_HID_MAX_INSTANCES as 2 or more in the build flags"
+#endif
+
+USBHIDDevice USBHID2(1);
+
+void setup(){
+  USBComposite.clear();
+  USBHID.setReportDescriptor(HID_KEYBOARD);
+  USBHID.registerComponent();
+  USBHID2.setReportDescriptor(HID_JOYSTICK);
+  USBHID2.setPollInterval(1);
+  USBHID2.registerComponent();
+  Joystick.setHID(USBHID2);
+  Joystick.setCoalescing(true);
+  USBComposite.begin();
+  delay(1000);
+}
+
+void loop(){
+  for (uint16 x = 0; x < 1024; x += 4) {
+    Joystick.X(x);
+    Joystick.Y(1023-x);
+    if (x == 512)
+      Keyboard.write('x');
+  }
+}
@@ -0,0 +1,37 @@
+#include <USBComposite.h>
+#include <HIDReportBuilder.h>
+
+/*
+ * A gamepad whose report descriptor and report layout both come from one
+ * definition: 12 buttons, a hat switch and two signed 8-bit sticks.
+ */
+
+using namespace HIDBuilder;
+
+typedef Report<0,
+    Buttons<12>,
+    Field<0x01, 4, 1, 0, 7, 0x39>,                   // hat switch
+    Field<0x01, 8, 4, -127, 127, 0x30, 0x31, 0x32, 0x35> // X, Y, Z, Rz
+> GamepadReport;
+
+typedef Descriptor<Application<0x01, 0x05, GamepadReport> > GamepadDescriptor;
+
+enum { BUTTONS, HAT, STICKS };
+
+HIDTypedReport<GamepadReport> gamepad;
+
+void setup(){
+  USBHID.begin(GamepadDescriptor::data, GamepadDescriptor::size);
+  delay(1000);
+}
+
+void loop(){
+  for (int i = -127; i <= 127; i++) {
+    gamepad.set<STICKS>(0, i);
+    gamepad.set<STICKS>(1, -i);
+    gamepad.set<BUTTONS>(0, i > 0);
+    gamepad.set<HAT>((i + 127) / 32);
+    gamepad.send();
+    delay(10);
+  }
+}
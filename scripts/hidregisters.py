@@ -0,0 +1,163 @@
+#!/usr/bin/env python3
+"""
+Host side of HIDRegisterMap (Linux hidraw).
+
+HIDRegisterMap gives access to a table in the device through two feature
+reports: writing (address, length) to the window report selects part of
+the table, and the data report then reads back a snapshot of it or writes
+to it.  Reading the window report returns the window, the table size and a
+mask of the 32 segments the firmware has changed since the host last read
+them.
+
+As a library:
+
+    import hidregisters
+    regs = hidregisters.RegisterMap(hidregisters.find_register_maps(0x1EAF, 0x0004)[0])
+    table = regs.read()
+    regs.write(4, b"\\xe8\\x03")
+
+As a tool, it prints the table, or the segments that have changed:
+
+    python3 scripts/hidregisters.py --pid 0x0004
+    python3 scripts/hidregisters.py --pid 0x0004 --changed
+    python3 scripts/hidregisters.py --pid 0x0004 --write 4 e803
+"""
+
+import argparse
+import fcntl
+import glob
+import os
+import struct
+import sys
+
+from hidstream import VENDOR_ID, RAWHID_USAGE_PAGE, usb_ids
+
+HID_REGISTER_MAP_USAGE = 0x0C02
+HID_REGISTER_MAP_REPORT_ID = 30
+WINDOW_FORMAT = "<HHHI"
+WINDOW_SIZE = struct.calcsize(WINDOW_FORMAT)
+
+
+def HIDIOCSFEATURE(length):
+    return (3 << 30) | (length << 16) | (ord("H") << 8) | 0x06
+
+
+def HIDIOCGFEATURE(length):
+    return (3 << 30) | (length << 16) | (ord("H") << 8) | 0x07
+
+
+def is_register_map(sysdir):
+    """True if the hidraw node's report descriptor has HID_REGISTER_MAP_REPORT_DESCRIPTOR."""
+    header = struct.pack("<BHBH", 0x06, RAWHID_USAGE_PAGE, 0x0A, HID_REGISTER_MAP_USAGE)
+    try:
+        with open(os.path.join(sysdir, "device", "report_descriptor"), "rb") as f:
+            return header in f.read()
+    except (IOError, OSError):
+        return False
+
+
+def find_register_maps(vid, pid):
+    """Return the hidraw nodes of the device's interfaces with a register map."""
+    nodes = []
+    for sysdir in glob.glob("/sys/class/hidraw/hidraw*"):
+        if usb_ids(os.path.join(sysdir, "device")) == (vid, pid) and is_register_map(sysdir):
+            nodes.append((os.path.realpath(os.path.join(sysdir, "device")), "/dev/" + os.path.basename(sysdir)))
+    return [node for _, node in sorted(nodes)]
+
+
+class RegisterMap(object):
+    def __init__(self, path, block_size=None, report_id=HID_REGISTER_MAP_REPORT_ID):
+        self.fd = os.open(path, os.O_RDWR)
+        self.report_id = report_id
+        self.block_size = block_size
+        self.size = self.window()[2]
+        if self.block_size is None:
+            # selecting a window of length 0 gets the largest one the device allows
+            self.select(0, 0)
+            self.block_size = self.window()[1] if self.size else 1
+
+    def close(self):
+        os.close(self.fd)
+
+    def window(self):
+        """Return (address, length, size, changed) from the window report."""
+        buf = bytearray(1 + WINDOW_SIZE)
+        buf[0] = self.report_id
+        fcntl.ioctl(self.fd, HIDIOCGFEATURE(len(buf)), buf)
+        return struct.unpack(WINDOW_FORMAT, bytes(buf[1:]))
+
+    def select(self, address, length):
+        """Select a window; the device takes its snapshot now."""
+        buf = bytearray([self.report_id]) + struct.pack(WINDOW_FORMAT, address, length, 0, 0)
+        fcntl.ioctl(self.fd, HIDIOCSFEATURE(len(buf)), buf)
+
+    def _data(self, length):
+        buf = bytearray(1 + self.block_size)
+        buf[0] = self.report_id + 1
+        fcntl.ioctl(self.fd, HIDIOCGFEATURE(len(buf)), buf)
+        return bytes(buf[1:1 + length])
+
+    def read(self, address=0, length=None):
+        """Read length bytes (the rest of the table by default), one window at a time."""
+        if length is None:
+            length = self.size - address
+        out = b""
+        while len(out) < length:
+            n = min(self.block_size, length - len(out))
+            self.select(address + len(out), n)
+            out += self._data(n)
+        return out
+
+    def write(self, address, data):
+        for offset in range(0, len(data), self.block_size):
+            chunk = data[offset:offset + self.block_size]
+            self.select(address + offset, len(chunk))
+            buf = bytearray([self.report_id + 1]) + chunk + bytearray(self.block_size - len(chunk))
+            fcntl.ioctl(self.fd, HIDIOCSFEATURE(len(buf)), buf)
+
+    def segment_size(self):
+        return (self.size + 31) // 32 if self.size > 32 else 1
+
+    def read_changed(self):
+        """Read the segments the firmware has changed; returns a list of (address, data)."""
+        changed = self.window()[3]
+        segment = self.segment_size()
+        out = []
+        for i in range(32):
+            if changed & (1 << i):
+                address = i * segment
+                out.append((address, self.read(address, min(segment, self.size - address))))
+        return out
+
+
+def hexdump(address, data):
+    for offset in range(0, len(data), 16):
+        print("%04x: %s" % (address + offset, " ".join("%02x" % b for b in data[offset:offset + 16])))
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--vid", type=lambda x: int(x, 0), default=VENDOR_ID)
+    ap.add_argument("--pid", type=lambda x: int(x, 0), required=True)
+    ap.add_argument("--report-id", type=lambda x: int(x, 0), default=HID_REGISTER_MAP_REPORT_ID)
+    ap.add_argument("--changed", action="store_true", help="only read the segments that have changed")
+    ap.add_argument("--write", nargs=2, metavar=("ADDRESS", "HEX"), help="write bytes to the table")
+    args = ap.parse_args()
+
+    paths = find_register_maps(args.vid, args.pid)
+    if not paths:
+        sys.exit("no register map for %04x:%04x found" % (args.vid, args.pid))
+
+    regs = RegisterMap(paths[0], report_id=args.report_id)
+    if args.write:
+        regs.write(int(args.write[0], 0), bytearray.fromhex(args.write[1]))
+    elif args.changed:
+        for address, data in regs.read_changed():
+            hexdump(address, data)
+    else:
+        hexdump(0, regs.read())
+    regs.close()
+
+
+if __name__ == "__main__":
+    main()
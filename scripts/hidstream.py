@@ -0,0 +1,165 @@
+#!/usr/bin/env python3
+"""
+Host side of HIDRawStream (Linux hidraw).
+
+HIDRawStream spreads a stream of reports over the interrupt endpoints of
+several HID interfaces.  Each interface shows up as its own hidraw node, and
+reports from different nodes arrive in no particular order relative to each
+other, so every report starts with a 16-bit little-endian sequence number.
+StreamReader reads all the nodes and hands out the payloads in sequence
+order.  A report still missing when `window` later ones have arrived is
+counted as lost and skipped.
+
+As a library:
+
+    import hidstream
+    reader = hidstream.StreamReader(hidstream.find_streams(0x1EAF, 0x35))
+    for payload in reader.payloads():
+        ...
+
+As a tool, it prints the rate for the examples/hidstream sketch:
+
+    python3 scripts/hidstream.py --pid 0x35 --seconds 5
+"""
+
+import argparse
+import glob
+import os
+import select
+import struct
+import sys
+import time
+
+VENDOR_ID = 0x1EAF
+RAWHID_USAGE_PAGE = 0xFFC0
+RAWHID_STREAM_USAGE = 0x0C01
+REPORT_SIZE = 64
+
+
+def usb_ids(sysdir):
+    """Walk up from a sysfs device directory to the USB device and return (vid, pid)."""
+    d = os.path.realpath(sysdir)
+    while d != "/":
+        try:
+            with open(os.path.join(d, "idVendor")) as f:
+                vid = int(f.read(), 16)
+            with open(os.path.join(d, "idProduct")) as f:
+                pid = int(f.read(), 16)
+            return vid, pid
+        except (IOError, OSError, ValueError):
+            d = os.path.dirname(d)
+    return None, None
+
+
+def is_stream(sysdir):
+    """True if the hidraw node's report descriptor is HID_RAW_STREAM_REPORT_DESCRIPTOR."""
+    header = struct.pack("<BHBH", 0x06, RAWHID_USAGE_PAGE, 0x0A, RAWHID_STREAM_USAGE)
+    try:
+        with open(os.path.join(sysdir, "device", "report_descriptor"), "rb") as f:
+            return f.read().startswith(header)
+    except (IOError, OSError):
+        return False
+
+
+def find_streams(vid, pid):
+    """Return the hidraw nodes of all stream interfaces of the device."""
+    nodes = []
+    for sysdir in glob.glob("/sys/class/hidraw/hidraw*"):
+        if usb_ids(os.path.join(sysdir, "device")) == (vid, pid) and is_stream(sysdir):
+            nodes.append((os.path.realpath(os.path.join(sysdir, "device")), "/dev/" + os.path.basename(sysdir)))
+    return [node for _, node in sorted(nodes)]
+
+
+class StreamReader(object):
+    def __init__(self, paths, report_size=REPORT_SIZE, window=64):
+        self.fds = [os.open(path, os.O_RDONLY) for path in paths]
+        self.report_size = report_size
+        self.window = window
+        self.expected = None
+        self.pending = {}
+        self.received = 0
+        self.lost = 0
+
+    def close(self):
+        for fd in self.fds:
+            os.close(fd)
+        self.fds = []
+
+    def _add(self, report):
+        seq = report[0] | (report[1] << 8)
+        self.received += 1
+        if self.expected is None:
+            self.expected = seq
+        if (seq - self.expected) & 0xFFFF >= 0x8000 or seq in self.pending:
+            return  # late or duplicate, already skipped
+        self.pending[seq] = report[2:]
+
+    def _ready(self):
+        out = []
+        while self.pending:
+            if self.expected in self.pending:
+                out.append(self.pending.pop(self.expected))
+                self.expected = (self.expected + 1) & 0xFFFF
+            elif len(self.pending) > self.window:
+                first = min(self.pending, key=lambda s: (s - self.expected) & 0xFFFF)
+                self.lost += (first - self.expected) & 0xFFFF
+                self.expected = first
+            else:
+                break
+        return out
+
+    def read(self, timeout=None):
+        """Wait for reports and return the payloads that are now in order (maybe none)."""
+        ready = select.select(self.fds, [], [], timeout)[0]
+        for fd in ready:
+            report = os.read(fd, self.report_size)
+            if len(report) > 2:
+                self._add(bytearray(report))
+        return self._ready()
+
+    def payloads(self, timeout=None):
+        """Yield payloads in order until no report comes for timeout seconds."""
+        while True:
+            if not select.select(self.fds, [], [], timeout)[0]:
+                return
+            for payload in self.read(0):
+                yield payload
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--vid", type=lambda x: int(x, 0), default=VENDOR_ID)
+    ap.add_argument("--pid", type=lambda x: int(x, 0), required=True)
+    ap.add_argument("--report-size", type=int, default=REPORT_SIZE)
+    ap.add_argument("--seconds", type=float, default=5.0)
+    args = ap.parse_args()
+
+    paths = find_streams(args.vid, args.pid)
+    if not paths:
+        sys.exit("no stream interfaces for %04x:%04x found" % (args.vid, args.pid))
+    print(" ".join(paths))
+
+    reader = StreamReader(paths, args.report_size)
+    count = 0
+    gaps = 0
+    last = None
+    start = time.monotonic()
+    while time.monotonic() - start < args.seconds:
+        for payload in reader.read(1.0):
+            # the example sketch puts a counter at the start of each payload
+            counter = struct.unpack("<I", bytes(payload[:4]))[0]
+            if last is not None and counter != (last + 1) & 0xFFFFFFFF:
+                gaps += 1
+            last = counter
+            count += 1
+    elapsed = time.monotonic() - start
+    reader.close()
+
+    print("%d payloads, %d bytes in %.3f s: %.1f /s, %.1f KB/s" % (
+        count, count * (args.report_size - 2), elapsed, count / elapsed,
+        count * (args.report_size - 2) / elapsed / 1e3))
+    print("%d lost, %d gaps in the payload counter" % (reader.lost, gaps))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,343 @@
+#!/usr/bin/env python3
+"""
+RAM / flash footprint report for representative USBComposite configurations.
+
+Each configuration is a tiny sketch that registers a particular combination of
+plugins.  The library and the sketch are compiled with arm-none-eabi-gcc against
+the libmaple headers of an Arduino_STM32 checkout and linked with
+--gc-sections, so only code and data reachable from that configuration is
+counted.  The core itself is not linked in (unresolved core symbols are
+ignored), which keeps the numbers to what this library contributes.
+
+The parts' buffers (HID tx ring, CDC rings, SCSI and bulk buffers) come from
+the USBComposite arena, which begin() would malloc().  So that they are counted,
+each sketch hands begin() a static arena, usbArena, of the size the parts need
+with their default buffer sizes; it is reported as the "arena" module.
+
+The output is a sorted, tab-separated table, one row per symbol plus per-module
+and per-configuration totals, so two reports can simply be diffed:
+
+    python3 scripts/memreport.py --core ~/Arduino/hardware/Arduino_STM32/STM32F1 -o mem.txt
+    python3 scripts/memreport.py --core ... --baseline mem.txt
+
+With --baseline, growth of .data+.bss (RAM) or .text+.rodata (flash) for any
+configuration is reported and the script exits with status 1.
+"""
+
+import argparse
+import os
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+from collections import defaultdict
+
+CONFIGS = {
+    "hid": """
+#include <USBComposite.h>
+static uint8_t usbArena[ARENA(USB_HID_DEFAULT_TX_BUFFER_SIZE)];
+void setup() {
+  USBComposite.setArena(usbArena, sizeof(usbArena));
+  USBHID.begin(HID_KEYBOARD_MOUSE);
+}
+void loop() {
+  Keyboard.press('a'); Keyboard.release('a'); Mouse.move(1, 1);
+}
+""",
+    "hid_cdc": """
+#include <USBComposite.h>
+static uint8_t usbArena[ARENA(USB_HID_DEFAULT_TX_BUFFER_SIZE) + CDC_ARENA];
+void setup() {
+  USBComposite.setArena(usbArena, sizeof(usbArena));
+  USBHID_begin_with_serial(HID_KEYBOARD_MOUSE);
+}
+void loop() {
+  Keyboard.press('a'); Keyboard.release('a'); Mouse.move(1, 1);
+  CompositeSerial.write((uint8)CompositeSerial.read());
+}
+""",
+    "midi_cdc": """
+#include <USBComposite.h>
+#include <USBMIDI.h>
+static uint8_t usbArena[MIDI_ARENA + CDC_ARENA];
+void setup() {
+  USBComposite.setArena(usbArena, sizeof(usbArena));
+  USBComposite.clear();
+  USBMIDI.registerComponent();
+  CompositeSerial.registerComponent();
+  USBComposite.begin();
+}
+void loop() {
+  USBMIDI.poll(); USBMIDI.sendNoteOn(0, 60, 127);
+  CompositeSerial.write((uint8)CompositeSerial.read());
+}
+""",
+    "mass_cdc": """
+#include <USBComposite.h>
+static bool rd(uint32_t o, uint8_t* b, uint16_t n) { (void)o; memset(b, 0, n); return true; }
+static uint8_t usbArena[MASS_ARENA + CDC_ARENA];
+void setup() {
+  USBComposite.setArena(usbArena, sizeof(usbArena));
+  USBComposite.clear();
+  MassStorage.setDrive(0, 65536, rd);
+  MassStorage.registerComponent();
+  CompositeSerial.registerComponent();
+  USBComposite.begin();
+}
+void loop() {
+  MassStorage.loop();
+  CompositeSerial.write((uint8)CompositeSerial.read());
+}
+""",
+    "all": """
+#include <USBComposite.h>
+#include <USBMIDI.h>
+static bool rd(uint32_t o, uint8_t* b, uint16_t n) { (void)o; memset(b, 0, n); return true; }
+static uint8_t usbArena[ARENA(USB_HID_DEFAULT_TX_BUFFER_SIZE) + CDC_ARENA + MIDI_ARENA + MASS_ARENA];
+void setup() {
+  USBComposite.setArena(usbArena, sizeof(usbArena));
+  USBComposite.clear();
+  USBHID.setReportDescriptor(HID_KEYBOARD_MOUSE_JOYSTICK);
+  USBHID.registerComponent();
+  CompositeSerial.registerComponent();
+  USBMIDI.registerComponent();
+  MassStorage.setDrive(0, 65536, rd);
+  MassStorage.registerComponent();
+  XBox360.registerComponent();
+  USBComposite.begin();
+}
+void loop() {
+  Keyboard.press('a'); Keyboard.release('a'); Mouse.move(1, 1); Joystick.X(0);
+  CompositeSerial.write((uint8)CompositeSerial.read());
+  USBMIDI.poll(); USBMIDI.sendNoteOn(0, 60, 127);
+  MassStorage.loop();
+  XBox360.X(0);
+}
+""",
+}
+
+# Arena space of each part with its default buffer sizes, rounded up to 4 bytes
+# like USBCompositeDevice::getArenaSize() does.
+PRELUDE = """#include <Arduino.h>
+#include "usb_hid.h"
+#include "usb_composite_serial.h"
+#include "usb_midi_device.h"
+#include "usb_mass.h"
+#include "usb_scsi.h"
+#define ARENA(n) (((n)+3)/4*4)
+#define CDC_ARENA ARENA(USBHID_CDCACM_DEFAULT_RX_BUFFER_SIZE + USBHID_CDCACM_DEFAULT_TX_BUFFER_SIZE)
+#define MIDI_ARENA ARENA(USB_MIDI_RX_EPSIZE)
+#define MASS_ARENA ARENA(SCSI_BLOCK_SIZE + MAX_BULK_PACKET_SIZE)
+"""
+
+SECTIONS = {
+    "t": "text", "w": "text",
+    "r": "rodata",
+    "d": "data",
+    "b": "bss",
+}
+
+CFLAGS = ["-mcpu=cortex-m3", "-mthumb", "-march=armv7-m", "-Os", "-g",
+          "-ffunction-sections", "-fdata-sections", "-w",
+          "-D__STM32F1__", "-DMCU_STM32F103CB", "-DARDUINO_ARCH_STM32F1",
+          "-DBOARD_generic_stm32f103c", "-DVECT_TAB_ADDR=0x8000000",
+          "-DERROR_LED_PORT=GPIOC", "-DERROR_LED_PIN=13",
+          "-DARDUINO=10805"]
+# The startup files (and with them __dso_handle) are not linked in, so static
+# destructors are registered through plain atexit().
+CXXFLAGS = ["-std=gnu++11", "-fno-rtti", "-fno-exceptions", "-fno-use-cxa-atexit"]
+
+
+def include_flags(core, variant):
+    system = os.path.join(core, "system", "libmaple")
+    dirs = [os.path.join(core, "cores", "maple"),
+            os.path.join(core, "variants", variant),
+            system,
+            os.path.join(system, "include"),
+            os.path.join(system, "stm32f1", "include"),
+            os.path.join(system, "usb", "stm32f1"),
+            os.path.join(system, "usb", "usb_lib")]
+    for d in dirs:
+        if not os.path.isdir(d):
+            sys.exit("memreport: missing include directory %s (check --core/--variant)" % d)
+    return ["-I" + d for d in dirs]
+
+
+def run(cmd):
+    p = subprocess.run(cmd, stdout=subprocess.PIPE, stderr=subprocess.PIPE, universal_newlines=True)
+    if p.returncode != 0:
+        sys.stderr.write(" ".join(cmd) + "\n" + p.stderr)
+        sys.exit("memreport: command failed")
+    return p.stdout
+
+
+def library_sources(libdir):
+    return sorted(f for f in os.listdir(libdir) if f.endswith(".c") or f.endswith(".cpp"))
+
+
+def compile_objects(args, sources, outdir, incs):
+    objects = {}
+    for src in sources:
+        path = src if os.path.isabs(src) else os.path.join(args.library, src)
+        module = os.path.splitext(os.path.basename(src))[0]
+        obj = os.path.join(outdir, module + ".o")
+        if src.endswith(".c"):
+            cmd = [args.prefix + "gcc", "-std=gnu11"]
+        else:
+            cmd = [args.prefix + "g++"] + CXXFLAGS
+        run(cmd + CFLAGS + incs + ["-I" + args.library, "-c", path, "-o", obj])
+        objects[module] = obj
+    return objects
+
+
+def symbol_modules(args, objects):
+    """Map each defined symbol name to the module whose object file defines it."""
+    owner = {}
+    for module, obj in objects.items():
+        for line in run([args.prefix + "nm", "--defined-only", obj]).splitlines():
+            parts = line.split()
+            if len(parts) == 3:
+                owner.setdefault(parts[2], module)
+    return owner
+
+
+def elf_symbols(args, elf):
+    symbols = []
+    out = run([args.prefix + "nm", "-S", "--size-sort", "-C", elf])
+    for line in out.splitlines():
+        m = re.match(r"^[0-9a-fA-F]+ ([0-9a-fA-F]+) (\w) (.+)$", line)
+        if not m:
+            continue
+        section = SECTIONS.get(m.group(2).lower())
+        if section is None:
+            continue
+        symbols.append((m.group(3), section, int(m.group(1), 16)))
+    return symbols
+
+
+def mangled_names(args, elf):
+    """nm -C loses the link to the raw names used by symbol_modules()."""
+    raw = run([args.prefix + "nm", "-S", "--size-sort", elf]).split("\n")
+    demangled = run([args.prefix + "nm", "-S", "--size-sort", "-C", elf]).split("\n")
+    names = {}
+    for r, d in zip(raw, demangled):
+        rp, dp = r.split(" ", 3), d.split(" ", 3)
+        if len(rp) == 4 and len(dp) == 4:
+            names[dp[3]] = rp[3]
+    return names
+
+
+def report_config(args, name, sketch, libobjects, owner, incs, outdir):
+    src = os.path.join(outdir, "sketch_%s.cpp" % name)
+    with open(src, "w") as f:
+        f.write(PRELUDE + sketch)
+    obj = os.path.join(outdir, "sketch_%s.o" % name)
+    run([args.prefix + "g++"] + CXXFLAGS + CFLAGS + incs + ["-I" + args.library, "-c", src, "-o", obj])
+    elf = os.path.join(outdir, name + ".elf")
+    run([args.prefix + "g++", "-mcpu=cortex-m3", "-mthumb", "-nostdlib", "-nostartfiles",
+         "-Wl,--gc-sections", "-Wl,--unresolved-symbols=ignore-all",
+         "-Wl,-e,_Z5setupv", "-Wl,-u,_Z4loopv", "-o", elf, obj] + sorted(libobjects.values()))
+
+    owner = dict(owner)
+    owner.update(symbol_modules(args, {"sketch": obj}))
+    raw = mangled_names(args, elf)
+    rows = []
+    for symbol, section, size in elf_symbols(args, elf):
+        module = "arena" if symbol == "usbArena" else owner.get(raw.get(symbol, symbol), "other")
+        rows.append((name, module, symbol, section, size))
+    return rows
+
+
+def write_report(rows, out):
+    modules = defaultdict(lambda: defaultdict(int))
+    configs = defaultdict(lambda: defaultdict(int))
+    for config, module, symbol, section, size in rows:
+        modules[(config, module)][section] += size
+        configs[config][section] += size
+
+    lines = []
+    for config, module, symbol, section, size in sorted(rows):
+        lines.append("symbol\t%s\t%s\t%s\t%s\t%d" % (config, module, symbol, section, size))
+    for (config, module), s in sorted(modules.items()):
+        for section in sorted(s):
+            lines.append("module\t%s\t%s\t%s\t%d" % (config, module, section, s[section]))
+    for config, s in sorted(configs.items()):
+        lines.append("total\t%s\tram\t%d" % (config, s["data"] + s["bss"]))
+        lines.append("total\t%s\tflash\t%d" % (config, s["text"] + s["rodata"] + s["data"]))
+    out.write("\n".join(lines) + "\n")
+    return configs
+
+
+def load_totals(path):
+    totals = {}
+    with open(path) as f:
+        for line in f:
+            parts = line.rstrip("\n").split("\t")
+            if parts[0] == "total" and len(parts) == 4:
+                totals[(parts[1], parts[2])] = int(parts[3])
+    return totals
+
+
+def compare(baseline, configs):
+    old = load_totals(baseline)
+    grew = False
+    for config, s in sorted(configs.items()):
+        for kind, value in (("ram", s["data"] + s["bss"]), ("flash", s["text"] + s["rodata"] + s["data"])):
+            before = old.get((config, kind))
+            if before is None:
+                continue
+            delta = value - before
+            if delta:
+                sys.stderr.write("%-10s %-5s %6d -> %6d (%+d)\n" % (config, kind, before, value, delta))
+            if delta > 0:
+                grew = True
+    return grew
+
+
+def main():
+    here = os.path.dirname(os.path.abspath(__file__))
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--core", default=os.environ.get("STM32F1_CORE"),
+                    help="Arduino_STM32 STM32F1 directory (or set STM32F1_CORE)")
+    ap.add_argument("--variant", default="generic_stm32f103c")
+    ap.add_argument("--library", default=os.path.dirname(here))
+    ap.add_argument("--prefix", default="arm-none-eabi-", help="toolchain prefix")
+    ap.add_argument("--config", action="append", choices=sorted(CONFIGS),
+                    help="configuration to build (default: all of them)")
+    ap.add_argument("-o", "--output", help="write the report here instead of stdout")
+    ap.add_argument("--baseline", help="previous report to compare totals against")
+    ap.add_argument("--keep", action="store_true", help="keep the build directory")
+    args = ap.parse_args()
+
+    if not args.core:
+        ap.error("--core is required")
+    if shutil.which(args.prefix + "gcc") is None:
+        ap.error("%sgcc not found" % args.prefix)
+
+    incs = include_flags(args.core, args.variant)
+    outdir = tempfile.mkdtemp(prefix="memreport-")
+    try:
+        libobjects = compile_objects(args, library_sources(args.library), outdir, incs)
+        owner = symbol_modules(args, libobjects)
+        rows = []
+        for name in args.config or sorted(CONFIGS):
+            rows += report_config(args, name, CONFIGS[name], libobjects, owner, incs, outdir)
+    finally:
+        if args.keep:
+            sys.stderr.write("build directory: %s\n" % outdir)
+        else:
+            shutil.rmtree(outdir)
+
+    if args.output:
+        with open(args.output, "w") as f:
+            configs = write_report(rows, f)
+    else:
+        configs = write_report(rows, sys.stdout)
+
+    if args.baseline and compare(args.baseline, configs):
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
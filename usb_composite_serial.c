@@ -60,6 +60,9 @@ static RESULT serialUSBDataSetup(uint8 request);
 static RESULT serialUSBNoDataSetup(uint8 request);
 static void vcomDataTxCb(void);
 static void vcomDataRxCb(void);
+static void serialSetArena(void* memory);
+static void serialSaveState(void* state);
+static void serialLoadState(const void* state);
 
 #define NUM_SERIAL_ENDPOINTS       3
 #define CCI_INTERFACE_OFFSET 	0x00
@@ -227,23 +230,31 @@ USBCompositePart usbSerialPart = {
     .usbReset = serialUSBReset,
     .usbDataSetup = serialUSBDataSetup,
     .usbNoDataSetup = serialUSBNoDataSetup,
-    .endpoints = serialEndpoints
+    .endpoints = serialEndpoints,
+    .arenaSize = USBHID_CDCACM_DEFAULT_RX_BUFFER_SIZE + USBHID_CDCACM_DEFAULT_TX_BUFFER_SIZE,
+    .usbSetArena = serialSetArena,
+    .usbSaveState = serialSaveState,
+    .usbLoadState = serialLoadState
 };
 
-#define CDC_SERIAL_RX_BUFFER_SIZE	256 // must be power of 2
+/* The buffers live in the USBComposite arena while the part is running. */
+
+#define CDC_SERIAL_RX_BUFFER_SIZE	vcomRxBufferSize // power of 2, see composite_cdcacm_set_buffer_sizes()
 #define CDC_SERIAL_RX_BUFFER_SIZE_MASK (CDC_SERIAL_RX_BUFFER_SIZE-1)
+static uint32 vcomRxBufferSize = USBHID_CDCACM_DEFAULT_RX_BUFFER_SIZE;
 
 /* Received data */
-static volatile uint8 vcomBufferRx[CDC_SERIAL_RX_BUFFER_SIZE];
+static volatile uint8* vcomBufferRx = NULL;
 /* Write index to vcomBufferRx */
 static volatile uint32 vcom_rx_head;
 /* Read index from vcomBufferRx */
 static volatile uint32 vcom_rx_tail;
 
-#define CDC_SERIAL_TX_BUFFER_SIZE	256 // must be power of 2
+#define CDC_SERIAL_TX_BUFFER_SIZE	vcomTxBufferSize // power of 2
 #define CDC_SERIAL_TX_BUFFER_SIZE_MASK (CDC_SERIAL_TX_BUFFER_SIZE-1)
+static uint32 vcomTxBufferSize = USBHID_CDCACM_DEFAULT_TX_BUFFER_SIZE;
 // Tx data
-static volatile uint8 vcomBufferTx[CDC_SERIAL_TX_BUFFER_SIZE];
+static volatile uint8* vcomBufferTx = NULL;
 // Write index to vcomBufferTx
 static volatile uint32 vcom_tx_head;
 // Read index from vcomBufferTx
@@ -277,6 +288,42 @@ void composite_cdcacm_set_hooks(unsigned hook_flags, void (*hook)(unsigned, void
     }
 }
 
+/* Takes effect the next time the part is started. The RX buffer has to
+ * hold two packets on top of the 64 unread bytes at which the endpoint is
+ * re-enabled, so it is at least 256 bytes. */
+void composite_cdcacm_set_buffer_sizes(uint32 rxSize, uint32 txSize) {
+    vcomRxBufferSize = usb_generic_ring_size(rxSize, USBHID_CDCACM_DEFAULT_RX_BUFFER_SIZE);
+    vcomTxBufferSize = usb_generic_ring_size(txSize, 8);
+    usbSerialPart.arenaSize = vcomRxBufferSize + vcomTxBufferSize;
+}
+
+// the buffer sizes, for a saved USBGenericLayout
+static void serialSaveState(void* state) {
+    ((uint32*)state)[0] = vcomRxBufferSize;
+    ((uint32*)state)[1] = vcomTxBufferSize;
+}
+
+static void serialLoadState(const void* state) {
+    vcomRxBufferSize = ((const uint32*)state)[0];
+    vcomTxBufferSize = ((const uint32*)state)[1];
+    usbSerialPart.arenaSize = vcomRxBufferSize + vcomTxBufferSize;
+}
+
+static void serialSetArena(void* memory) {
+    if (memory == NULL) {
+        vcomBufferRx = NULL;
+        vcomBufferTx = NULL;
+    }
+    else {
+        vcomBufferRx = memory;
+        vcomBufferTx = vcomBufferRx + vcomRxBufferSize;
+    }
+    vcom_rx_head = 0;
+    vcom_rx_tail = 0;
+    vcom_tx_head = 0;
+    vcom_tx_tail = 0;
+}
+
 void composite_cdcacm_putc(char ch) {
     while (!composite_cdcacm_tx((uint8*)&ch, 1))
         ;
@@ -289,6 +336,7 @@ void composite_cdcacm_putc(char ch) {
 uint32 composite_cdcacm_tx(const uint8* buf, uint32 len)
 {
 	if (len==0) return 0; // no data to send
+	if (vcomBufferTx == NULL) return len; // not running, nowhere to send it
 
 	uint32 head = vcom_tx_head; // load volatile variable
 	uint32 tx_unsent = (head - vcom_tx_tail) & CDC_SERIAL_TX_BUFFER_SIZE_MASK;
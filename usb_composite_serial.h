@@ -58,6 +58,8 @@ extern USBCompositePart usbSerialPart;
 #define USBHID_CDCACM_MANAGEMENT_EPSIZE      0x10
 #define USBHID_CDCACM_RX_EPSIZE              0x40
 #define USBHID_CDCACM_TX_EPSIZE              0x40
+#define USBHID_CDCACM_DEFAULT_RX_BUFFER_SIZE 256
+#define USBHID_CDCACM_DEFAULT_TX_BUFFER_SIZE 256
 /*
  * Descriptors, etc.
  */
@@ -98,6 +100,7 @@ typedef struct
  */
 
 void   composite_cdcacm_putc(char ch);
+void   composite_cdcacm_set_buffer_sizes(uint32 rxSize, uint32 txSize);
 uint32 composite_cdcacm_tx(const uint8* buf, uint32 len);
 uint32 composite_cdcacm_rx(uint8* buf, uint32 len);
 uint32 composite_cdcacm_peek(uint8* buf, uint32 len);
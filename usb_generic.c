@@ -39,6 +39,7 @@
 #include <libmaple/nvic.h>
 #include <libmaple/delay.h>
 #include <libmaple/gpio.h>
+#include <libmaple/systick.h>
 #include <usb_lib_globals.h>
 #include <usb_reg_map.h>
 //#include <usb_core.h>
@@ -61,6 +62,7 @@ static uint8* usbGetConfigDescriptor(uint16 length);
 static void usbInit(void);
 static void usbReset(void);
 static void usbClearFeature(void);
+static void usbStatusIn(void);
 static void usbSetConfiguration(void);
 static RESULT usbDataSetup(uint8 request);
 static RESULT usbNoDataSetup(uint8 request);
@@ -70,6 +72,8 @@ static uint8* usbGetConfigDescriptor(uint16 length);
 static uint8* usbGetDeviceDescriptor(uint16 length);
 static void usbSetConfiguration(void);
 static void usbSetDeviceAddress(void);
+static void usbStandardRequest(void);
+static void usbTimelineRecord(uint8 event, uint8 request, uint16 value);
 
 #define LEAFLABS_ID_VENDOR                0x1EAF
 #define MAPLE_ID_PRODUCT                  0x0004 // was 0x0024
@@ -159,7 +163,7 @@ const usb_descriptor_string usb_generic_default_iProduct = {
 static DEVICE_PROP my_Device_Property = {
     .Init                        = usbInit,
     .Reset                       = usbReset,
-    .Process_Status_IN           = NOP_Process, 
+    .Process_Status_IN           = usbStatusIn,
     .Process_Status_OUT          = NOP_Process,
     .Class_Data_Setup            = usbDataSetup,
     .Class_NoData_Setup          = usbNoDataSetup,
@@ -172,14 +176,14 @@ static DEVICE_PROP my_Device_Property = {
 };
 
 static const USER_STANDARD_REQUESTS my_User_Standard_Requests = {
-    .User_GetConfiguration   = NOP_Process,
+    .User_GetConfiguration   = usbStandardRequest,
     .User_SetConfiguration   = usbSetConfiguration,
-    .User_GetInterface       = NOP_Process,
-    .User_SetInterface       = NOP_Process,
-    .User_GetStatus          = NOP_Process,
+    .User_GetInterface       = usbStandardRequest,
+    .User_SetInterface       = usbStandardRequest,
+    .User_GetStatus          = usbStandardRequest,
     .User_ClearFeature       = usbClearFeature,
-    .User_SetEndPointFeature = NOP_Process,
-    .User_SetDeviceFeature   = NOP_Process,
+    .User_SetEndPointFeature = usbStandardRequest,
+    .User_SetDeviceFeature   = usbStandardRequest,
     .User_SetDeviceAddress   = usbSetDeviceAddress
 };
 
@@ -203,7 +207,20 @@ static USER_STANDARD_REQUESTS saved_User_Standard_Requests;
 static void (*ep_int_in[7])(void);
 static void (*ep_int_out[7])(void);
 
+#ifdef USB_FAST_ATTACH
+static uint8 fastAttach = 1;
+#else
+static uint8 fastAttach = 0;
+#endif
+static uint8 configCached = 0;
+
+#if USB_TIMELINE_SIZE > 0
+static USBTimelineEvent timeline[USB_TIMELINE_SIZE];
+#endif
+static volatile uint32 timelineLength = 0;
+
 uint8 usb_generic_set_parts(USBCompositePart** _parts, unsigned _numParts) {
+    configCached = 0;
     parts = _parts;
     numParts = _numParts;
     unsigned numInterfaces = 0;
@@ -255,10 +272,139 @@ uint8 usb_generic_set_parts(USBCompositePart** _parts, unsigned _numParts) {
     Config_Descriptor.Descriptor_Size = usbConfig.Config_Header.wTotalLength;
     
     my_Device_Table.Total_Endpoint = numEndpoints;
+    
+    configCached = 1;
         
     return 1;
 }
 
+/* Must follow a successful usb_generic_set_parts(). */
+void usb_generic_save_layout(USBGenericLayout* layout) {
+    memcpy(layout->config, &usbConfig, usbConfig.Config_Header.wTotalLength);
+    layout->numEndpoints = my_Device_Table.Total_Endpoint;
+    memcpy(layout->ep_int_in, ep_int_in, sizeof(ep_int_in));
+    memcpy(layout->ep_int_out, ep_int_out, sizeof(ep_int_out));
+    
+    unsigned n = 0;
+    for (unsigned i = 0 ; i < numParts ; i++) {
+        layout->partEndpoints[i] = parts[i]->numEndpoints;
+        layout->partDescriptorSize[i] = parts[i]->descriptorSize;
+        layout->partArenaSize[i] = parts[i]->arenaSize;
+        if (parts[i]->usbSaveState != NULL)
+            parts[i]->usbSaveState(layout->partState[i]);
+        for (unsigned j = 0 ; j < parts[i]->numEndpoints ; j++) {
+            layout->endpoints[n] = &(parts[i]->endpoints[j]);
+            layout->pmaAddress[n] = parts[i]->endpoints[j].pmaAddress;
+            n++;
+        }
+    }
+}
+
+/* _parts must be the parts the layout was saved with, in the same order. 
+ * The device must not be enabled. */
+void usb_generic_load_layout(const USBGenericLayout* layout, USBCompositePart** _parts, unsigned _numParts) {
+    parts = _parts;
+    numParts = _numParts;
+    
+    unsigned numInterfaces = 0;
+    unsigned numEndpoints = 1;
+    for (unsigned i = 0 ; i < _numParts ; i++) {
+        // another profile may have changed the part since
+        parts[i]->numEndpoints = layout->partEndpoints[i];
+        parts[i]->descriptorSize = layout->partDescriptorSize[i];
+        parts[i]->arenaSize = layout->partArenaSize[i];
+        if (parts[i]->usbLoadState != NULL)
+            parts[i]->usbLoadState(layout->partState[i]);
+        parts[i]->startInterface = numInterfaces;
+        parts[i]->startEndpoint = numEndpoints;
+        numInterfaces += parts[i]->numInterfaces;
+        numEndpoints += parts[i]->numEndpoints;
+    }
+    
+    for (unsigned i = 0 ; i + 1 < layout->numEndpoints ; i++) {
+        layout->endpoints[i]->address = i + 1;
+        layout->endpoints[i]->pmaAddress = layout->pmaAddress[i];
+    }
+    
+    memcpy(&usbConfig, layout->config, ((usb_descriptor_config_header*)layout->config)->wTotalLength);
+    Config_Descriptor.Descriptor_Size = usbConfig.Config_Header.wTotalLength;
+    memcpy(ep_int_in, layout->ep_int_in, sizeof(ep_int_in));
+    memcpy(ep_int_out, layout->ep_int_out, sizeof(ep_int_out));
+    my_Device_Table.Total_Endpoint = layout->numEndpoints;
+    
+    configCached = 1;
+}
+
+/* With fast attach on, USBCompositeDevice::begin() reuses the configuration
+ * from the previous usb_generic_set_parts() call when the parts have not
+ * changed, which saves rebuilding the descriptors. The disconnect pulse is
+ * the same either way (USB_GENERIC_RESET_PULSE_US). */
+void usb_generic_set_fast_attach(uint8 fast) {
+    fastAttach = fast;
+}
+
+uint8 usb_generic_get_fast_attach(void) {
+    return fastAttach;
+}
+
+uint8 usb_generic_config_cached(void) {
+    return configCached;
+}
+
+/* Parts call this when something that ends up in their descriptors changes. */
+void usb_generic_invalidate_config(void) {
+    configCached = 0;
+}
+
+/* Ring buffers are indexed with a mask, so sizes are rounded up to a power of 2. */
+uint32 usb_generic_ring_size(uint32 size, uint32 minimum) {
+    uint32 n = minimum;
+    while (n < size)
+        n <<= 1;
+    return n;
+}
+
+uint32 usb_generic_micros(void) {
+    uint32 ms;
+    uint32 count;
+    
+    do {
+        ms = systick_uptime();
+        count = systick_get_count();
+    } while (ms != systick_uptime());
+    
+    return ms * 1000 + (SYSTICK_BASE->RVR + 1 - count) / CYCLES_PER_MICROSECOND;
+}
+
+/* Events since the last usb_generic_enable(), oldest first. Recording
+ * stops when the timeline is full. */
+uint32 usb_generic_get_timeline(const USBTimelineEvent** events) {
+#if USB_TIMELINE_SIZE > 0
+    *events = timeline;
+    return timelineLength;
+#else
+    *events = NULL;
+    return 0;
+#endif
+}
+
+static void usbTimelineRecord(uint8 event, uint8 request, uint16 value) {
+#if USB_TIMELINE_SIZE > 0
+    if (timelineLength >= USB_TIMELINE_SIZE)
+        return;
+    USBTimelineEvent* e = &timeline[timelineLength];
+    e->micros = usb_generic_micros();
+    e->event = event;
+    e->request = request;
+    e->value = value;
+    timelineLength++;
+#else
+    (void)event;
+    (void)request;
+    (void)value;
+#endif
+}
+
 void usb_generic_set_info( uint16 idVendor, uint16 idProduct, const uint8* iManufacturer, const uint8* iProduct, const uint8* iSerialNumber) {
     if (idVendor != 0)
         usbGenericDescriptor_Device.idVendor = idVendor;
@@ -306,10 +452,13 @@ void usb_generic_enable(void) {
     gpio_set_mode(GPIOA, 12, GPIO_OUTPUT_PP);
     gpio_write_bit(GPIOA, 12, 0);
     
-    for(volatile unsigned int i=0;i<512;i++);// Only small delay seems to be needed
+    delay_us(USB_GENERIC_RESET_PULSE_US); // Only small delay seems to be needed
     gpio_set_mode(GPIOA, 12, GPIO_INPUT_FLOATING);
 #endif			
 
+    timelineLength = 0;
+    usbTimelineRecord(USB_TIMELINE_ENABLE, 0, 0);
+
     if (BOARD_USB_DISC_DEV != NULL) {
         gpio_set_mode(BOARD_USB_DISC_DEV, (uint8)(uint32)BOARD_USB_DISC_BIT, GPIO_OUTPUT_PP);
         gpio_write_bit(BOARD_USB_DISC_DEV, (uint8)(uint32)BOARD_USB_DISC_BIT, 0);
@@ -394,6 +543,7 @@ static void usbReset(void) {
     usbGenericTransmitting = -1;
     
     USBLIB->state = USB_ATTACHED;
+    usbTimelineRecord(USB_TIMELINE_ATTACHED, 0, 0);
     SetDeviceAddress(0);
 
 }
@@ -414,6 +564,7 @@ void usb_generic_disable(void) {
     }
     
     usb_power_down();
+    USBLIB->state = USB_UNCONNECTED;
 
     Device_Table = saved_Device_Table;
     Device_Property = saved_Device_Property;
@@ -456,6 +607,7 @@ static RESULT usbNoDataSetup(uint8 request) {
 static void usbSetConfiguration(void) {
     if (pInformation->Current_Configuration != 0) {
         USBLIB->state = USB_CONFIGURED;
+        usbTimelineRecord(USB_TIMELINE_CONFIGURED, SET_CONFIGURATION, pInformation->Current_Configuration);
     }
     for (unsigned i = 0 ; i < numParts ; i++) {
         if (parts[i]->usbSetConfiguration != NULL)
@@ -464,27 +616,47 @@ static void usbSetConfiguration(void) {
 }
 
 static void usbClearFeature(void) {
+    usbStandardRequest();
     for (unsigned i = 0 ; i < numParts ; i++) {
         if (parts[i]->usbClearFeature != NULL)
             parts[i]->usbClearFeature();
     }
 }
 
+static void usbStatusIn(void) {
+    for (unsigned i = 0 ; i < numParts ; i++) {
+        if (parts[i]->usbStatusIn != NULL)
+            parts[i]->usbStatusIn();
+    }
+}
+
 static void usbSetDeviceAddress(void) {
     USBLIB->state = USB_ADDRESSED;
+    usbTimelineRecord(USB_TIMELINE_ADDRESSED, SET_ADDRESS, pInformation->USBwValue);
+}
+
+static void usbStandardRequest(void) {
+    usbTimelineRecord(USB_TIMELINE_REQUEST, pInformation->USBbRequest, pInformation->USBwValue);
 }
 
 static uint8* usbGetDeviceDescriptor(uint16 length) {
+    if (length == 0)
+        usbStandardRequest();
     return Standard_GetDescriptorData(length, &Device_Descriptor);
 }
 
 static uint8* usbGetConfigDescriptor(uint16 length) {
+    if (length == 0)
+        usbStandardRequest();
     return Standard_GetDescriptorData(length, &Config_Descriptor);
 }
 
 static uint8* usbGetStringDescriptor(uint16 length) {    
     uint8 wValue0 = pInformation->USBwValue0;
     
+    if (length == 0)
+        usbStandardRequest();
+    
     if (wValue0 >= numStringDescriptors) {
         return NULL;
     }
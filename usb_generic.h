@@ -8,11 +8,29 @@ typedef unsigned char u8;
 
 #define PMA_MEMORY_SIZE 512
 #define MAX_USB_DESCRIPTOR_DATA_SIZE 200
+#define USB_GENERIC_MAX_PARTS 6
+#define USB_GENERIC_PART_STATE_SIZE 24 // bytes a layout keeps for each part's usbSaveState()
 
 #define USB_EP0_BUFFER_SIZE       0x40
 #define USB_EP0_TX_BUFFER_ADDRESS 0x40
 #define USB_EP0_RX_BUFFER_ADDRESS (USB_EP0_TX_BUFFER_ADDRESS+USB_EP0_BUFFER_SIZE) 
 
+// number of enumeration events kept by the timeline; 0 compiles it out
+#ifndef USB_TIMELINE_SIZE
+#define USB_TIMELINE_SIZE 32
+#endif
+
+#define USB_TIMELINE_ENABLE     0
+#define USB_TIMELINE_ATTACHED   1 // bus reset
+#define USB_TIMELINE_ADDRESSED  2
+#define USB_TIMELINE_CONFIGURED 3
+#define USB_TIMELINE_REQUEST    4 // other standard request, see request and value
+
+/* How long the GENERIC_BOOTLOADER disconnect pulse holds D+ low. TDDIS
+ * (2.5us) is the spec minimum, but hubs sample the line much more slowly;
+ * this is about what the old busy loop took at 72MHz, which is known to work. */
+#define USB_GENERIC_RESET_PULSE_US 70
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -42,13 +60,53 @@ typedef struct USBCompositePart {
     void (*usbClearFeature)(void);
     RESULT (*usbDataSetup)(uint8 request);
     RESULT (*usbNoDataSetup)(uint8 request);
+    void (*usbStatusIn)(void); // a control transfer has finished with its status stage
     USBEndpointInfo* endpoints;
+    uint16 arenaSize; // bytes of buffer space the part needs while it is running
+    void (*usbSetArena)(void* memory); // memory is NULL when the buffers are taken away
+    /* Settings of the part that its descriptors and buffers were built from, at most
+     * USB_GENERIC_PART_STATE_SIZE bytes, kept by usb_generic_save_layout() and put back
+     * by usb_generic_load_layout(). NULL if there are none. */
+    void (*usbSaveState)(void* state);
+    void (*usbLoadState)(const void* state);
 } USBCompositePart;
 
+/* A configuration built by usb_generic_set_parts(), saved so that it can be
+ * brought back later without rebuilding the descriptors. */
+typedef struct USBGenericLayout {
+    uint8 config[sizeof(usb_descriptor_config_header) + MAX_USB_DESCRIPTOR_DATA_SIZE];
+    uint8 numEndpoints;
+    void (*ep_int_in[7])(void);
+    void (*ep_int_out[7])(void);
+    USBEndpointInfo* endpoints[7];
+    uint16 pmaAddress[7];
+    // for each part, in order
+    uint8 partEndpoints[USB_GENERIC_MAX_PARTS];
+    uint16 partDescriptorSize[USB_GENERIC_MAX_PARTS];
+    uint16 partArenaSize[USB_GENERIC_MAX_PARTS];
+    uint32 partState[USB_GENERIC_MAX_PARTS][USB_GENERIC_PART_STATE_SIZE/4];
+} USBGenericLayout;
+
+typedef struct USBTimelineEvent {
+    uint32 micros;
+    uint8 event;
+    uint8 request; // bRequest
+    uint16 value; // wValue
+} USBTimelineEvent;
+
 void usb_generic_set_info(uint16 idVendor, uint16 idProduct, const uint8* iManufacturer, const uint8* iProduct, const uint8* iSerialNumber);
 uint8 usb_generic_set_parts(USBCompositePart** _parts, unsigned _numParts);
+void usb_generic_save_layout(USBGenericLayout* layout);
+void usb_generic_load_layout(const USBGenericLayout* layout, USBCompositePart** _parts, unsigned _numParts);
 void usb_generic_disable(void);
 void usb_generic_enable(void);
+void usb_generic_set_fast_attach(uint8 fast);
+uint8 usb_generic_get_fast_attach(void);
+uint8 usb_generic_config_cached(void);
+void usb_generic_invalidate_config(void);
+uint32 usb_generic_get_timeline(const USBTimelineEvent** events);
+uint32 usb_generic_micros(void);
+uint32 usb_generic_ring_size(uint32 size, uint32 minimum);
 extern volatile int8 usbGenericTransmitting;
 void usb_copy_from_pma(uint8 *buf, uint16 len, uint16 pma_offset);
 void usb_copy_to_pma(const uint8 *buf, uint16 len, uint16 pma_offset);
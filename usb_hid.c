@@ -50,42 +50,216 @@ uint16 GetEPTxAddr(uint8 /*bEpNum*/);
 #include "usb_core.h"
 #include "usb_def.h"
 
-static uint32 ProtocolValue = 0;
-
-static void hidDataTxCb(void);
-static void hidUSBReset(void);
-static RESULT hidUSBDataSetup(uint8 request);
-static RESULT hidUSBNoDataSetup(uint8 request);
-//static RESULT usbGetInterfaceSetting(uint8 interface, uint8 alt_setting);
-static uint8* HID_GetReportDescriptor(uint16 Length);
-static uint8* HID_GetProtocolValue(uint16 Length);
-
-static volatile HIDBuffer_t hidBuffers[MAX_HID_BUFFERS] = {{ 0 }};
-static volatile HIDBuffer_t* currentHIDBuffer = NULL;
+#if USB_HID_MAX_INSTANCES < 1 || USB_HID_MAX_INSTANCES > 4
+#error "USB_HID_MAX_INSTANCES must be between 1 and 4"
+#endif
+#if MAX_HID_BUFFERS < 1 || MAX_HID_BUFFERS > 127
+#error "MAX_HID_BUFFERS must be between 1 and 127"
+#endif
+
+// at most half full, so that probing stays short and always finds a free slot
+#define HID_BUFFER_HASH_SIZE (2*MAX_HID_BUFFERS)
+#define HID_BUFFER_HASH(outputMode, reportID) (((reportID)*2u+((outputMode)!=0)) % HID_BUFFER_HASH_SIZE)
+#define HID_BUFFER_WORDS ((MAX_HID_BUFFERS+31)/32)
 
 //#define DUMMY_BUFFER_SIZE 0x40 // at least as big as a buffer size
 
 #define HID_INTERFACE_OFFSET 	0x00
-#define NUM_HID_ENDPOINTS          1
-#define HID_INTERFACE_NUMBER (HID_INTERFACE_OFFSET+usbHIDPart.startInterface)
+#define NUM_HID_ENDPOINTS          2 // the OUT endpoint is only used if enabled
+
+#define HID_REPORT_HEADER_SIZE 2
+
+/* Reports with a queue of their own (see usb_hid_set_report_queue()) are kept
+ * in depth slots of the report's size, in the arena after bufferTx, followed
+ * by the time each slot was queued at. */
+typedef struct {
+    volatile uint8* data;
+    volatile uint32* queuedAt;
+    uint16 size; // 0 if the queue is unused
+    uint8 reportID;
+    uint8 policy;
+    uint8 depth;
+    uint8 priority;
+    uint8 skipped; // times the queue had a report ready but another one was sent
+    uint8 hasLast; // slot tail+count-1 holds the last report queued (sent or not)
+    uint8 idle; // idle rate set by the host, in 4 ms units, 0 for indefinite
+    uint32 lastQueuedAt; // micros
+    volatile uint8 tail;
+    volatile uint8 count;
+    HIDReportStats stats;
+} HIDReportQueue_t;
+
+/* Everything belonging to one HID interface. The part callbacks have no
+ * arguments, so each instance gets small wrappers (see HID_CALLBACKS()) that
+ * pass its HIDInterface_t on. */
+typedef struct {
+    ONE_DESCRIPTOR reportDescriptor;
+    uint32 protocolValue; // set by the host: 0 boot protocol, 1 report protocol
+    uint8 interfaceProtocol; // boot interface protocol in the descriptor: 0 none, 1 keyboard, 2 mouse
+    uint8 idle; // idle rate the host set for all reports (report ID 0), in 4 ms units
+    volatile HIDBuffer_t buffers[MAX_HID_BUFFERS];
+    uint8 numBuffers;
+    // 1 + index into buffers, 0 for an empty slot; see usb_hid_find_buffer()
+    uint8 bufferIndex[HID_BUFFER_HASH_SIZE];
+    // one bit per buffer in the HID_BUFFER_UNREAD state
+    volatile uint32 unread[HID_BUFFER_WORDS];
+    uint8 pollInterval;
+    // each HID interface has its own endpoint, so it keeps its own copy of usbGenericTransmitting
+    volatile int8 transmitting;
+    uint8 outEndpoint; // output reports also come in through an interrupt OUT endpoint
+    // output buffer the report coming in through the OUT endpoint goes to, and how much of it arrived
+    volatile HIDBuffer_t* rxBuffer;
+    uint16 rxOffset;
+    // a packet is waiting in the OUT endpoint until its output buffer has been read
+    volatile uint8 rxPending;
+    // written by the SET_REPORT in progress; its callback runs once the status stage is done
+    volatile HIDBuffer_t* setReportBuffer;
+
+    uint32 txBufferSize; // power of 2, see usb_hid_set_tx_buffer_size()
+    /* Reports without a queue of their own, in the USBComposite arena while the
+     * part is running. Each report is stored whole, as a two byte length followed
+     * by the data, and is sent in packets of its own, so reports are never split
+     * across packets or interleaved with each other. */
+    volatile uint8* bufferTx;
+    // Write index to bufferTx
+    volatile uint32 txHead;
+    // Read index from bufferTx
+    volatile uint32 txTail;
+    // Bytes of the report at txTail that are still to be sent, 0 if none was started
+    uint32 txReportLeft;
+    // The current report ends on a packet boundary, so a zero length packet follows it
+    uint8 txZlp;
+
+    /* A report sent straight from the caller's memory, see usb_hid_tx_stream().
+     * It goes out in back-to-back full packets and does not have to fit in bufferTx. */
+    const uint8* volatile streamData;
+    volatile uint32 streamLeft;
+    uint32 streamSize;
+    // the stream report's packets are on their way, it completes when the last one is acknowledged
+    volatile uint8 txStreaming;
+    volatile uint32 streamCompleted;
+
+    // let reporters generate their reports as the endpoint asks for them
+    struct {
+        HIDTxIdleCallback callback;
+        void* context;
+    } txIdle[MAX_HID_TX_IDLE_CALLBACKS];
+    uint8 numTxIdle;
+
+    HIDReportQueue_t queues[MAX_HID_REPORT_QUEUES];
+#if MAX_HID_LAST_REPORTS > 0
+    // report IDs without a queue: the last report sent through the tx buffer, and the idle rate
+    struct {
+        uint8 used;
+        uint8 reportID;
+        uint8 idle;
+        uint8 size; // 0 until a report has been sent
+        uint8 data[USB_HID_LAST_REPORT_SIZE];
+    } lastReports[MAX_HID_LAST_REPORTS];
+#endif
+    // where hidSendQueuedReport() starts looking, so that equal priorities take turns
+    uint8 nextQueue;
+    // reports in bufferTx compete with the queues as if they had a queue of priority 0
+    uint8 sharedSkipped;
+} HIDInterface_t;
+
+#define HID_INTERFACE_DEFAULTS { \
+        .reportDescriptor = { (uint8*)NULL, 0 }, \
+        .protocolValue = 1, \
+        .pollInterval = 0x0A, \
+        .transmitting = -1, \
+        .txBufferSize = USB_HID_DEFAULT_TX_BUFFER_SIZE, \
+    }
+
+static HIDInterface_t hidInterfaces[USB_HID_MAX_INSTANCES] = {
+    HID_INTERFACE_DEFAULTS,
+#if USB_HID_MAX_INSTANCES > 1
+    HID_INTERFACE_DEFAULTS,
+#endif
+#if USB_HID_MAX_INSTANCES > 2
+    HID_INTERFACE_DEFAULTS,
+#endif
+#if USB_HID_MAX_INSTANCES > 3
+    HID_INTERFACE_DEFAULTS,
+#endif
+};
+
+// the interface whose control request is in progress, for the CopyRoutines
+static HIDInterface_t* hidControl = NULL;
+static volatile HIDBuffer_t* currentHIDBuffer = NULL;
+/* The memory of currentHIDBuffer that a SET_REPORT or GET_REPORT(Feature) is
+ * using, until the last packet. usb_hid_set_feature() leaves it alone. */
+static volatile uint8* hidControlData = NULL;
+// see usb_hid_lock()
+static volatile uint32 hidLockDepth = 0;
+// answers to GET_REPORT(Input) and GET_IDLE
+static uint8 hidInput[USB_HID_TX_EPSIZE];
+static uint16 hidInputSize;
+static uint8 hidIdleValue;
+
+#define HID_PART(hid) (usbHIDParts[(hid)-hidInterfaces])
+#define HID_INTERFACE_NUMBER(hid) (HID_INTERFACE_OFFSET+HID_PART(hid).startInterface)
+
+#define HID_TX_BUFFER_SIZE_MASK(hid) ((hid)->txBufferSize-1)
+
+#define REPORT_QUEUE_DATA_SIZE(q) (((q)->size*(q)->depth+3)&~3)
+#define REPORT_QUEUE_SIZE(q) (REPORT_QUEUE_DATA_SIZE(q)+(q)->depth*sizeof(uint32))
+#define REPORT_QUEUE_SLOT(q,n) ((q)->data+(q)->size*((n)%(q)->depth))
+
+static void hidDataTxCb(HIDInterface_t* hid);
+static void hidDataRxCb(HIDInterface_t* hid);
+static void hidUSBReset(HIDInterface_t* hid);
+static void hidStatusIn(HIDInterface_t* hid);
+static void hidBufferWritten(HIDInterface_t* hid, volatile HIDBuffer_t* buffer);
+static uint8* HID_GetFeature(uint16 length);
+static void hidSetArena(HIDInterface_t* hid, void* memory);
+static void hidSaveState(HIDInterface_t* hid, void* state);
+static void hidLoadState(HIDInterface_t* hid, const void* state);
+static RESULT hidUSBDataSetup(HIDInterface_t* hid, uint8 request);
+static RESULT hidUSBNoDataSetup(HIDInterface_t* hid, uint8 request);
+static void getHIDPartDescriptor(HIDInterface_t* hid, uint8* out);
+//static RESULT usbGetInterfaceSetting(uint8 interface, uint8 alt_setting);
+static uint8* HID_GetReportDescriptor(uint16 Length);
+static uint8* HID_GetProtocolValue(uint16 Length);
+static uint8* HID_GetInput(uint16 Length);
+static uint8* HID_GetIdle(uint16 Length);
+
+#define HID_CALLBACKS(n) \
+    static void hidDataTxCb##n(void) { hidDataTxCb(hidInterfaces+n); } \
+    static void hidDataRxCb##n(void) { hidDataRxCb(hidInterfaces+n); } \
+    static void hidUSBReset##n(void) { hidUSBReset(hidInterfaces+n); } \
+    static void hidStatusIn##n(void) { hidStatusIn(hidInterfaces+n); } \
+    static void hidSetArena##n(void* memory) { hidSetArena(hidInterfaces+n, memory); } \
+    static void hidSaveState##n(void* state) { hidSaveState(hidInterfaces+n, state); } \
+    static void hidLoadState##n(const void* state) { hidLoadState(hidInterfaces+n, state); } \
+    static RESULT hidUSBDataSetup##n(uint8 request) { return hidUSBDataSetup(hidInterfaces+n, request); } \
+    static RESULT hidUSBNoDataSetup##n(uint8 request) { return hidUSBNoDataSetup(hidInterfaces+n, request); } \
+    static void getHIDPartDescriptor##n(uint8* out) { getHIDPartDescriptor(hidInterfaces+n, out); }
+
+HID_CALLBACKS(0)
+#if USB_HID_MAX_INSTANCES > 1
+HID_CALLBACKS(1)
+#endif
+#if USB_HID_MAX_INSTANCES > 2
+HID_CALLBACKS(2)
+#endif
+#if USB_HID_MAX_INSTANCES > 3
+HID_CALLBACKS(3)
+#endif
 
 /*
  * Descriptors
  */
- 
-static ONE_DESCRIPTOR HID_Report_Descriptor = {
-    (uint8*)NULL,
-    0
-};
-
 
 #define HID_ENDPOINT_TX      0
+#define HID_ENDPOINT_RX      1
 
 typedef struct {
     //HID
     usb_descriptor_interface     	HID_Interface;
 	HIDDescriptor			 	 	HID_Descriptor;
     usb_descriptor_endpoint      	HIDDataInEndpoint;
+    usb_descriptor_endpoint      	HIDDataOutEndpoint; // left out unless enabled
 } __packed hid_part_config;
 
 static const hid_part_config hidPartConfigData = {
@@ -94,10 +268,10 @@ static const hid_part_config hidPartConfigData = {
         .bDescriptorType    = USB_DESCRIPTOR_TYPE_INTERFACE,
         .bInterfaceNumber   = HID_INTERFACE_OFFSET, // PATCH
         .bAlternateSetting  = 0x00,
-        .bNumEndpoints      = NUM_HID_ENDPOINTS,    
+        .bNumEndpoints      = 1, // PATCH    
         .bInterfaceClass    = USB_INTERFACE_CLASS_HID,
         .bInterfaceSubClass = USB_INTERFACE_SUBCLASS_HID,
-        .bInterfaceProtocol = 0x00, /* Common AT Commands */
+        .bInterfaceProtocol = 0x00, /* PATCH */
         .iInterface         = 0x00,
 	},
 	.HID_Descriptor = {
@@ -117,53 +291,96 @@ static const hid_part_config hidPartConfigData = {
         .bEndpointAddress = USB_DESCRIPTOR_ENDPOINT_IN | HID_ENDPOINT_TX, // PATCH
         .bmAttributes     = USB_ENDPOINT_TYPE_INTERRUPT,
         .wMaxPacketSize   = USB_HID_TX_EPSIZE,//0x40,//big enough for a keyboard 9 byte packet and for a mouse 5 byte packet
-        .bInterval        = 0x0A,
+        .bInterval        = 0x0A, // PATCH
+	},
+	.HIDDataOutEndpoint = {
+		.bLength          = sizeof(usb_descriptor_endpoint),
+        .bDescriptorType  = USB_DESCRIPTOR_TYPE_ENDPOINT,
+        .bEndpointAddress = USB_DESCRIPTOR_ENDPOINT_OUT | HID_ENDPOINT_RX, // PATCH
+        .bmAttributes     = USB_ENDPOINT_TYPE_INTERRUPT,
+        .wMaxPacketSize   = USB_HID_RX_EPSIZE,
+        .bInterval        = 0x0A, // PATCH
 	}
 };
 
-static USBEndpointInfo hidEndpoints[1] = {
-    {
-        .callback = hidDataTxCb,
-        .bufferSize = USB_HID_TX_EPSIZE,
-        .type = USB_EP_EP_TYPE_INTERRUPT, // TODO: interrupt???
-        .tx = 1,
-    }
+#define HID_ENDPOINTS(n) { \
+    { \
+        .callback = hidDataTxCb##n, \
+        .bufferSize = USB_HID_TX_EPSIZE, \
+        .type = USB_EP_EP_TYPE_INTERRUPT, /* TODO: interrupt??? */ \
+        .tx = 1, \
+    }, \
+    { \
+        .callback = hidDataRxCb##n, \
+        .bufferSize = USB_HID_RX_EPSIZE, \
+        .type = USB_EP_EP_TYPE_INTERRUPT, \
+        .tx = 0, \
+    } \
+}
+
+static USBEndpointInfo hidEndpoints[USB_HID_MAX_INSTANCES][NUM_HID_ENDPOINTS] = {
+    HID_ENDPOINTS(0),
+#if USB_HID_MAX_INSTANCES > 1
+    HID_ENDPOINTS(1),
+#endif
+#if USB_HID_MAX_INSTANCES > 2
+    HID_ENDPOINTS(2),
+#endif
+#if USB_HID_MAX_INSTANCES > 3
+    HID_ENDPOINTS(3),
+#endif
 };
 
 #define OUT_BYTE(s,v) out[(uint8*)&(s.v)-(uint8*)&s]
 
-static void getHIDPartDescriptor(uint8* out) {
-    memcpy(out, &hidPartConfigData, sizeof(hid_part_config));
+static void getHIDPartDescriptor(HIDInterface_t* hid, uint8* out) {
+    memcpy(out, &hidPartConfigData, HID_PART(hid).descriptorSize);
     // patch to reflect where the part goes in the descriptor
-    OUT_BYTE(hidPartConfigData, HID_Interface.bInterfaceNumber) += usbHIDPart.startInterface;
-    OUT_BYTE(hidPartConfigData, HIDDataInEndpoint.bEndpointAddress) += usbHIDPart.startEndpoint;
-    OUT_BYTE(hidPartConfigData, HID_Descriptor.descLenL) = (uint8)HID_Report_Descriptor.Descriptor_Size;
-    OUT_BYTE(hidPartConfigData, HID_Descriptor.descLenH) = (uint8)(HID_Report_Descriptor.Descriptor_Size>>8);
-}
-
-USBCompositePart usbHIDPart = {
-    .numInterfaces = 1,
-    .numEndpoints = sizeof(hidEndpoints)/sizeof(*hidEndpoints),
-    .descriptorSize = sizeof(hid_part_config),
-    .getPartDescriptor = getHIDPartDescriptor,
-    .usbInit = NULL,
-    .usbReset = hidUSBReset,
-    .usbDataSetup = hidUSBDataSetup,
-    .usbNoDataSetup = hidUSBNoDataSetup,
-    .usbClearFeature = NULL,
-    .usbSetConfiguration = NULL,
-    .endpoints = hidEndpoints
-};
+    OUT_BYTE(hidPartConfigData, HID_Interface.bInterfaceNumber) += HID_PART(hid).startInterface;
+    OUT_BYTE(hidPartConfigData, HIDDataInEndpoint.bEndpointAddress) += HID_PART(hid).startEndpoint;
+    OUT_BYTE(hidPartConfigData, HID_Descriptor.descLenL) = (uint8)hid->reportDescriptor.Descriptor_Size;
+    OUT_BYTE(hidPartConfigData, HID_Descriptor.descLenH) = (uint8)(hid->reportDescriptor.Descriptor_Size>>8);
+    OUT_BYTE(hidPartConfigData, HIDDataInEndpoint.bInterval) = hid->pollInterval;
+    OUT_BYTE(hidPartConfigData, HID_Interface.bInterfaceProtocol) = hid->interfaceProtocol;
+    if (hid->outEndpoint) {
+        OUT_BYTE(hidPartConfigData, HID_Interface.bNumEndpoints) = 2;
+        OUT_BYTE(hidPartConfigData, HIDDataOutEndpoint.bEndpointAddress) += HID_PART(hid).startEndpoint;
+        OUT_BYTE(hidPartConfigData, HIDDataOutEndpoint.bInterval) = hid->pollInterval;
+    }
+}
 
+#define HID_PART_INIT(n) { \
+    .numInterfaces = 1, \
+    .numEndpoints = 1, \
+    .descriptorSize = sizeof(hid_part_config)-sizeof(usb_descriptor_endpoint), \
+    .getPartDescriptor = getHIDPartDescriptor##n, \
+    .usbInit = NULL, \
+    .usbReset = hidUSBReset##n, \
+    .usbDataSetup = hidUSBDataSetup##n, \
+    .usbNoDataSetup = hidUSBNoDataSetup##n, \
+    .usbClearFeature = NULL, \
+    .usbSetConfiguration = NULL, \
+    .usbStatusIn = hidStatusIn##n, \
+    .endpoints = hidEndpoints[n], \
+    .arenaSize = USB_HID_DEFAULT_TX_BUFFER_SIZE, \
+    .usbSetArena = hidSetArena##n, \
+    .usbSaveState = hidSaveState##n, \
+    .usbLoadState = hidLoadState##n \
+}
+
+USBCompositePart usbHIDParts[USB_HID_MAX_INSTANCES] = {
+    HID_PART_INIT(0),
+#if USB_HID_MAX_INSTANCES > 1
+    HID_PART_INIT(1),
+#endif
+#if USB_HID_MAX_INSTANCES > 2
+    HID_PART_INIT(2),
+#endif
+#if USB_HID_MAX_INSTANCES > 3
+    HID_PART_INIT(3),
+#endif
+};
 
-#define HID_TX_BUFFER_SIZE	256 // must be power of 2
-#define HID_TX_BUFFER_SIZE_MASK (HID_TX_BUFFER_SIZE-1)
-// Tx data
-static volatile uint8 hidBufferTx[HID_TX_BUFFER_SIZE];
-// Write index to hidBufferTx
-static volatile uint32 hid_tx_head = 0;
-// Read index from hidBufferTx
-static volatile uint32 hid_tx_tail = 0;
 
 #define CDC_SERIAL_RX_BUFFER_SIZE	256 // must be power of 2
 #define CDC_SERIAL_RX_BUFFER_SIZE_MASK (CDC_SERIAL_RX_BUFFER_SIZE-1)
@@ -171,8 +388,8 @@ static volatile uint32 hid_tx_tail = 0;
  
 
 
-void usb_hid_putc(char ch) {
-    while (!usb_hid_tx((uint8*)&ch, 1))
+void usb_hid_putc(uint8 instance, char ch) {
+    while (!usb_hid_tx(instance, (uint8*)&ch, 1))
         ;
 }
 
@@ -193,61 +410,187 @@ static void hidStatusIn() {
 }
     */
 
-void usb_hid_set_report_descriptor(const uint8* report_descriptor, uint16 report_descriptor_length) {    
-    HID_Report_Descriptor.Descriptor = (uint8*)report_descriptor;
-    HID_Report_Descriptor.Descriptor_Size = report_descriptor_length;        
+void usb_hid_set_report_descriptor(uint8 instance, const uint8* report_descriptor, uint16 report_descriptor_length) {
+    HIDInterface_t* hid = hidInterfaces + instance;
+    hid->reportDescriptor.Descriptor = (uint8*)report_descriptor;
+    hid->reportDescriptor.Descriptor_Size = report_descriptor_length;
+    usb_generic_invalidate_config();
 }
 
     
-static volatile HIDBuffer_t* usb_hid_find_buffer(uint8 type, uint8 reportID) {
+/* Open addressing with linear probing: a report ID's buffer is at its hash
+ * slot or in one of the occupied slots right after it. */
+static volatile HIDBuffer_t* usb_hid_find_buffer(HIDInterface_t* hid, uint8 type, uint8 reportID) {
     uint8 typeTest = type == HID_REPORT_TYPE_OUTPUT ? HID_BUFFER_MODE_OUTPUT : 0;
-    for (int i=0; i<MAX_HID_BUFFERS; i++) {
-        if ( hidBuffers[i].buffer != NULL &&
-             ( hidBuffers[i].mode & HID_BUFFER_MODE_OUTPUT ) == typeTest && 
-             hidBuffers[i].reportID == reportID) {
-            return hidBuffers+i;
-        }
+    unsigned slot = HID_BUFFER_HASH(typeTest, reportID);
+    uint8 index;
+    while (0 != (index = hid->bufferIndex[slot])) {
+        volatile HIDBuffer_t* buffer = hid->buffers + index - 1;
+        if (( buffer->mode & HID_BUFFER_MODE_OUTPUT ) == typeTest && buffer->reportID == reportID)
+            return buffer;
+        slot = (slot + 1) % HID_BUFFER_HASH_SIZE;
     }
     return NULL;
 }
 
-void usb_hid_set_feature(uint8 reportID, uint8* data) {
-    volatile HIDBuffer_t* buffer = usb_hid_find_buffer(HID_REPORT_TYPE_FEATURE, reportID);
-    if (buffer != NULL) {
-        usb_set_ep_rx_stat(USB_EP0, USB_EP_STAT_RX_NAK);
-        unsigned delta = reportID != 0;
+static void hidIndexBuffer(HIDInterface_t* hid, unsigned i) {
+    unsigned slot = HID_BUFFER_HASH(hid->buffers[i].mode & HID_BUFFER_MODE_OUTPUT, hid->buffers[i].reportID);
+    while (hid->bufferIndex[slot] != 0)
+        slot = (slot + 1) % HID_BUFFER_HASH_SIZE;
+    hid->bufferIndex[slot] = i + 1;
+}
+
+static void hidSetBufferState(HIDInterface_t* hid, volatile HIDBuffer_t* buffer, uint8 state) {
+    unsigned i = buffer - hid->buffers;
+    buffer->state = state;
+    if (state == HID_BUFFER_UNREAD)
+        hid->unread[i/32] |= 1ul << (i%32);
+    else
+        hid->unread[i/32] &= ~(1ul << (i%32));
+}
+
+static void hidCallBufferCallback(volatile HIDBuffer_t* buffer) {
+    unsigned delta = buffer->reportID != 0;
+    uint16 length = buffer->currentDataSize > delta ? buffer->currentDataSize - delta : 0;
+    if (buffer->callback != NULL)
+        buffer->callback(buffer->callbackContext, (const uint8*)buffer->buffer + delta, length);
+}
+
+// the callback has seen the data, so it counts as read
+static void hidBufferCallbackDone(HIDInterface_t* hid, volatile HIDBuffer_t* buffer) {
+    if (buffer->state == HID_BUFFER_UNREAD)
+        hidSetBufferState(hid, buffer, HID_BUFFER_READ);
+    if (hid->rxPending)
+        hidDataRxCb(hid); // the buffer may have room for it now
+}
+
+/* The host has finished writing buffer; called in the USB interrupt */
+static void hidBufferWritten(HIDInterface_t* hid, volatile HIDBuffer_t* buffer) {
+    if (buffer->callback == NULL)
+        return;
+    if (buffer->mode & HID_BUFFER_MODE_DEFER_CALLBACK) {
+        buffer->callbackPending = 1;
+        return;
+    }
+    hidCallBufferCallback(buffer);
+    hidBufferCallbackDone(hid, buffer);
+}
+
+/* Has callback called whenever the host writes the buffer of type
+ * HID_REPORT_TYPE_OUTPUT or HID_REPORT_TYPE_FEATURE with reportID, by
+ * SET_REPORT or through the OUT endpoint, instead of having to poll for it.
+ * The buffer has to have been added already. The callback runs in the USB
+ * interrupt, or if deferred, from the next usb_hid_run_buffer_callbacks().
+ * Once it returns, the data counts as read. A NULL callback removes it.
+ * Returns 0 if there is no such buffer. */
+uint8 usb_hid_set_buffer_callback(uint8 instance, uint8 type, uint8 reportID, HIDBufferCallback callback, void* context, uint8 deferred) {
+    HIDInterface_t* hid = hidInterfaces + instance;
+    volatile HIDBuffer_t* buffer = usb_hid_find_buffer(hid, type, reportID);
+    if (buffer == NULL)
+        return 0;
+    usb_hid_lock();
+    buffer->callback = callback;
+    buffer->callbackContext = context;
+    buffer->callbackPending = 0;
+    if (deferred)
+        buffer->mode |= HID_BUFFER_MODE_DEFER_CALLBACK;
+    else
+        buffer->mode &= ~HID_BUFFER_MODE_DEFER_CALLBACK;
+    usb_hid_unlock();
+    return 1;
+}
+
+/* Runs the deferred callbacks of the buffers written since the last call.
+ * Unless a buffer has HID_BUFFER_MODE_NO_WAIT, the host cannot write it again
+ * until its callback has run. */
+void usb_hid_run_buffer_callbacks(uint8 instance) {
+    HIDInterface_t* hid = hidInterfaces + instance;
+    for (unsigned i = 0; i < hid->numBuffers; i++) {
+        volatile HIDBuffer_t* buffer = hid->buffers + i;
+        if (!buffer->callbackPending)
+            continue;
+        buffer->callbackPending = 0;
+        hidCallBufferCallback(buffer);
+        usb_hid_lock();
+        hidBufferCallbackDone(hid, buffer);
+        usb_hid_unlock();
+    }
+}
+
+/* Sets the feature report the host gets with GET_REPORT. If the buffer has a
+ * backBuffer, data is copied there while the host can still read the old
+ * report, and then the two swap places, so that the host always gets a whole
+ * report and the copy never holds up the control endpoint. Without one, the
+ * copy is made with the USB interrupt off. Returns 0 if there is no such
+ * buffer, or if the host is in the middle of a transfer of this report that
+ * takes several packets and needs the memory the data would go to; try
+ * again later. */
+uint8 usb_hid_set_feature(uint8 instance, uint8 reportID, const uint8* data) {
+    HIDInterface_t* hid = hidInterfaces + instance;
+    volatile HIDBuffer_t* buffer = usb_hid_find_buffer(hid, HID_REPORT_TYPE_FEATURE, reportID);
+    if (buffer == NULL)
+        return 0;
+    unsigned delta = reportID != 0;
+    volatile uint8* back = buffer->backBuffer;
+
+    if (back == NULL) {
+        usb_hid_lock();
+        if (hidControlData == buffer->buffer) {
+            usb_hid_unlock();
+            return 0;
+        }
         memcpy((uint8*)buffer->buffer+delta, data, buffer->bufferSize-delta);
         if (reportID)
             buffer->buffer[0] = reportID;
-        buffer->currentDataSize = buffer->bufferSize;
-        buffer->state = HID_BUFFER_READ;
-        usb_set_ep_rx_stat(USB_EP0, USB_EP_STAT_RX_VALID);
-        return;
     }
+    else {
+        // only a transfer that began before the last swap can be using back, and none can start on it
+        if (hidControlData == back)
+            return 0;
+        memcpy((uint8*)back+delta, data, buffer->bufferSize-delta);
+        if (reportID)
+            back[0] = reportID;
+        usb_hid_lock();
+        if (hidControlData == buffer->buffer && pInformation->Ctrl_Info.CopyData != HID_GetFeature) {
+            // swapping now would split the host's SET_REPORT between the two
+            usb_hid_unlock();
+            return 0;
+        }
+        buffer->backBuffer = buffer->buffer;
+        buffer->buffer = back;
+    }
+    buffer->currentDataSize = buffer->bufferSize;
+    hidSetBufferState(hid, buffer, HID_BUFFER_READ);
+    usb_hid_unlock();
+    return 1;
 }
 
 static uint8 have_unread_data_in_hid_buffer() {
-    for (int i=0;i<MAX_HID_BUFFERS; i++) {
-        if (hidBuffers[i].buffer != NULL && hidBuffers[i].state == HID_BUFFER_UNREAD)
-            return 1;
+    for (int n=0; n<USB_HID_MAX_INSTANCES; n++) {
+        for (int i=0; i<HID_BUFFER_WORDS; i++) {
+            if (hidInterfaces[n].unread[i])
+                return 1;
+        }
     }
     return 0;
 }
 
-uint16_t usb_hid_get_data(uint8 type, uint8 reportID, uint8* out, uint8 poll) {
+uint16_t usb_hid_get_data(uint8 instance, uint8 type, uint8 reportID, uint8* out, uint8 poll) {
     volatile HIDBuffer_t* buffer;
     unsigned ret = 0;
     
-    buffer = usb_hid_find_buffer(type, reportID);
+    HIDInterface_t* hid = hidInterfaces + instance;
+
+    buffer = usb_hid_find_buffer(hid, type, reportID);
     
     if (buffer == NULL)
         return 0;
 
-    nvic_irq_disable(NVIC_USB_LP_CAN_RX0);
+    usb_hid_lock();
 
     if (buffer->reportID == reportID && buffer->state != HID_BUFFER_EMPTY && !(poll && buffer->state == HID_BUFFER_READ)) {
         if (buffer->bufferSize != buffer->currentDataSize) {
-           buffer->state = HID_BUFFER_EMPTY;
+           hidSetBufferState(hid, buffer, HID_BUFFER_EMPTY);
            ret = 0;
         }
         else {
@@ -256,7 +599,7 @@ uint16_t usb_hid_get_data(uint8 type, uint8 reportID, uint8* out, uint8 poll) {
                 memcpy(out, (uint8*)buffer->buffer+delta, buffer->bufferSize-delta);
             
             if (poll) {
-                buffer->state = HID_BUFFER_READ;
+                hidSetBufferState(hid, buffer, HID_BUFFER_READ);
             }
 
             ret = buffer->bufferSize-delta;
@@ -267,144 +610,844 @@ uint16_t usb_hid_get_data(uint8 type, uint8 reportID, uint8* out, uint8 poll) {
         usb_set_ep_rx_stat(USB_EP0, USB_EP_STAT_RX_VALID);
     }
 
-    nvic_irq_enable(NVIC_USB_LP_CAN_RX0);
+    if (hid->rxPending)
+        hidDataRxCb(hid); // the buffer may have room for it now
+
+    usb_hid_unlock();
             
     return ret;
 }
 
-void usb_hid_clear_buffers(uint8 type) {
+void usb_hid_clear_buffers(uint8 instance, uint8 type) {
+    HIDInterface_t* hid = hidInterfaces + instance;
     uint8 typeTest = type == HID_REPORT_TYPE_OUTPUT ? HID_BUFFER_MODE_OUTPUT : 0;
-    for (int i=0; i<MAX_HID_BUFFERS; i++) {
-        if (( hidBuffers[i].mode & HID_BUFFER_MODE_OUTPUT ) == typeTest) {
-            hidBuffers[i].buffer = NULL;
+    unsigned n = 0;
+
+    usb_hid_lock();
+
+    // the buffers of the other type move down, so the index and the unread bits are rebuilt
+    memset(hid->bufferIndex, 0, sizeof(hid->bufferIndex));
+    memset((void*)hid->unread, 0, sizeof(hid->unread));
+    for (unsigned i=0; i<hid->numBuffers; i++) {
+        if (( hid->buffers[i].mode & HID_BUFFER_MODE_OUTPUT ) != typeTest) {
+            hid->buffers[n] = hid->buffers[i];
+            hidIndexBuffer(hid, n);
+            if (hid->buffers[n].state == HID_BUFFER_UNREAD)
+                hidSetBufferState(hid, hid->buffers+n, HID_BUFFER_UNREAD);
+            n++;
         }
     }
+    hid->numBuffers = n;
+    // the buffers a transfer in progress was using may have moved
+    hid->rxBuffer = NULL;
+    hid->setReportBuffer = NULL;
+    currentHIDBuffer = NULL;
+    hidControlData = NULL;
+
+    usb_hid_unlock();
 }
 
-uint8 usb_hid_add_buffer(uint8 type, volatile HIDBuffer_t* buf) {
+uint8 usb_hid_add_buffer(uint8 instance, uint8 type, volatile HIDBuffer_t* buf) {
+    HIDInterface_t* hid = hidInterfaces + instance;
     if (type == HID_BUFFER_MODE_OUTPUT) 
         buf->mode |= HID_BUFFER_MODE_OUTPUT;
     else
         buf->mode &= ~HID_BUFFER_MODE_OUTPUT;
     memset((void*)buf->buffer, 0, buf->bufferSize);
     buf->buffer[0] = buf->reportID;
+    if (buf->backBuffer != NULL) {
+        memset((void*)buf->backBuffer, 0, buf->bufferSize);
+        buf->backBuffer[0] = buf->reportID;
+    }
 
-    volatile HIDBuffer_t* buffer = usb_hid_find_buffer(type, buf->reportID);
+    volatile HIDBuffer_t* buffer = usb_hid_find_buffer(hid, type, buf->reportID);
 
-    if (buffer != NULL) {
+    if (buffer == NULL) {
+        if (hid->numBuffers >= MAX_HID_BUFFERS)
+            return 0;
+        buffer = hid->buffers + hid->numBuffers;
         *buffer = *buf;
-        return 1;
+        hidIndexBuffer(hid, hid->numBuffers++);
     }
     else {
-        for (int i=0; i<MAX_HID_BUFFERS; i++) {
-            if (hidBuffers[i].buffer == NULL) {
-                hidBuffers[i] = *buf;
-                return 1;
-            }
-        }
-        return 0;
+        *buffer = *buf;
     }
+    hidSetBufferState(hid, buffer, buffer->state);
+    return 1;
 }
 
-void usb_hid_set_buffers(uint8 type, volatile HIDBuffer_t* bufs, int n) {
+void usb_hid_set_buffers(uint8 instance, uint8 type, volatile HIDBuffer_t* bufs, int n) {
     uint8 typeMask = type == HID_REPORT_TYPE_OUTPUT ? HID_BUFFER_MODE_OUTPUT : 0;
-    usb_hid_clear_buffers(type);
+    usb_hid_clear_buffers(instance, type);
     for (int i=0; i<n; i++) {
         bufs[i].mode &= ~HID_REPORT_TYPE_OUTPUT;
         bufs[i].mode |= typeMask;
-        usb_hid_add_buffer(type, bufs+i);
+        usb_hid_add_buffer(instance, type, bufs+i);
     }
     currentHIDBuffer = NULL;
 }
 
 /* This function is non-blocking.
  *
- * It copies data from a user buffer into the USB peripheral TX
- * buffer, and returns the number of bytes copied. */
-uint32 usb_hid_tx(const uint8* buf, uint32 len)
+ * It queues buf as one report, and returns len if it was queued (or had
+ * to be dropped because it can never fit in the tx buffer) and 0 if there
+ * is no room for it yet. */
+uint32 usb_hid_tx(uint8 instance, const uint8* buf, uint32 len)
 {
+    HIDInterface_t* hid = hidInterfaces + instance;
+
 	if (len==0) return 0; // no data to send
+	if (hid->bufferTx == NULL) return len; // not running, nowhere to send it
+	if (len + HID_REPORT_HEADER_SIZE > hid->txBufferSize-1) return len; // too big for the buffer
 
-	uint32 head = hid_tx_head; // load volatile variable
-	uint32 tx_unsent = (head - hid_tx_tail) & HID_TX_BUFFER_SIZE_MASK;
+    usb_hid_lock();
 
-    // We can only put bytes in the buffer if there is place
-    if (len > (HID_TX_BUFFER_SIZE-tx_unsent-1) ) {
-        len = (HID_TX_BUFFER_SIZE-tx_unsent-1);
+	uint32 head = hid->txHead; // load volatile variable
+	uint32 tx_unsent = (head - hid->txTail) & HID_TX_BUFFER_SIZE_MASK(hid);
+
+    // The whole report goes in, or nothing does
+    if (len + HID_REPORT_HEADER_SIZE > hid->txBufferSize-tx_unsent-1) {
+        usb_hid_unlock();
+        return 0;
     }
-	if (len==0) return 0; // buffer full
 
-	uint16 i;
+	hid->bufferTx[head] = (uint8)len;
+	head = (head+1) & HID_TX_BUFFER_SIZE_MASK(hid);
+	hid->bufferTx[head] = (uint8)(len>>8);
+	head = (head+1) & HID_TX_BUFFER_SIZE_MASK(hid);
+
+	uint32 i;
 	// copy data from user buffer to USB Tx buffer
 	for (i=0; i<len; i++) {
-		hidBufferTx[head] = buf[i];
-		head = (head+1) & HID_TX_BUFFER_SIZE_MASK;
+		hid->bufferTx[head] = buf[i];
+		head = (head+1) & HID_TX_BUFFER_SIZE_MASK(hid);
 	}
-	hid_tx_head = head; // store volatile variable
+	hid->txHead = head; // store volatile variable
 
-	while(usbGenericTransmitting >= 0);
-	
-	if (usbGenericTransmitting<0) {
-		hidDataTxCb(); // initiate data transmission
+	if (hid->transmitting<0) {
+		hidDataTxCb(hid); // initiate data transmission
 	}
 
+    usb_hid_unlock();
+
     return len;
 }
 
+static HIDReportQueue_t* usb_hid_find_report_queue(HIDInterface_t* hid, uint8 reportID) {
+    for (int i=0; i<MAX_HID_REPORT_QUEUES; i++) {
+        if (hid->queues[i].size != 0 && hid->queues[i].reportID == reportID)
+            return hid->queues+i;
+    }
+    return NULL;
+}
+
+static void hidUpdateArenaSize(HIDInterface_t* hid) {
+    uint32 size = hid->txBufferSize;
+    for (int i=0; i<MAX_HID_REPORT_QUEUES; i++)
+        size += REPORT_QUEUE_SIZE(hid->queues+i);
+    HID_PART(hid).arenaSize = size;
+}
+
+/* Gives reports with this ID a queue of their own, of depth reports of size
+ * bytes at most USB_HID_TX_EPSIZE, handled according to policy:
+ *
+ * HID_QUEUE_FIFO: every report is sent, in order
+ * HID_QUEUE_KEEP_LATEST: when the queue is full, the newest queued report is
+ *     replaced, so the host gets the latest state on the next poll
+ * HID_QUEUE_DROP_DUPLICATE: like HID_QUEUE_FIFO, but a report identical to
+ *     the last one queued is dropped, unless the idle rate set by the host
+ *     (SET_IDLE) has passed since then
+ *
+ * A report with a queue also answers GET_REPORT(Input) with the last report
+ * queued, and usb_hid_send_idle_reports() repeats it at the idle rate.
+ *
+ * A depth of 0 removes the queue, and the reports go through the tx buffer
+ * again. The slots are reserved at the next begin(); until then the reports
+ * go through the tx buffer. */
+uint8 usb_hid_set_report_queue(uint8 instance, uint8 reportID, uint16 size, uint8 policy, uint8 depth) {
+    HIDInterface_t* hid = hidInterfaces + instance;
+    HIDReportQueue_t* queue = usb_hid_find_report_queue(hid, reportID);
+
+    if (depth == 0) {
+        if (queue != NULL) {
+            queue->count = 0;
+            queue->size = 0;
+            queue->data = NULL;
+            hidUpdateArenaSize(hid);
+        }
+        return 1;
+    }
 
+    if (size == 0 || size > USB_HID_TX_EPSIZE || policy > HID_QUEUE_DROP_DUPLICATE)
+        return 0;
 
-uint16 usb_hid_get_pending(void) {
-    return (hid_tx_head - hid_tx_tail) & HID_TX_BUFFER_SIZE_MASK;
+    if (queue == NULL) {
+        for (int i=0; i<MAX_HID_REPORT_QUEUES; i++) {
+            if (hid->queues[i].size == 0) {
+                queue = hid->queues+i;
+                break;
+            }
+        }
+        if (queue == NULL)
+            return 0;
+    }
+    else if (queue->size == size && queue->depth == depth) {
+        queue->policy = policy;
+        return 1;
+    }
+
+    if (queue->size == 0) {
+        queue->priority = 0;
+        queue->idle = hid->idle;
+    }
+    queue->count = 0;
+    queue->data = NULL;
+    queue->queuedAt = NULL;
+    queue->reportID = reportID;
+    queue->policy = policy;
+    queue->depth = depth;
+    queue->size = size;
+    hidUpdateArenaSize(hid);
+    return 1;
+}
+
+/* When the endpoint is free, the pending report with the highest priority is
+ * sent next. Every time a report is passed over, the priority of its queue
+ * goes up by one until it is sent, so low priorities are delayed but never
+ * starved. Reports without a queue of their own have priority 0. */
+uint8 usb_hid_set_report_priority(uint8 instance, uint8 reportID, uint8 priority) {
+    HIDReportQueue_t* queue = usb_hid_find_report_queue(hidInterfaces+instance, reportID);
+    if (queue == NULL)
+        return 0;
+    queue->priority = priority;
+    return 1;
+}
+
+/* Latencies are from queueing a report to handing it to the endpoint, in
+ * microseconds. */
+uint8 usb_hid_get_report_stats(uint8 instance, uint8 reportID, HIDReportStats* stats) {
+    HIDReportQueue_t* queue = usb_hid_find_report_queue(hidInterfaces+instance, reportID);
+    if (queue == NULL)
+        return 0;
+    usb_hid_lock();
+    *stats = queue->stats;
+    usb_hid_unlock();
+    return 1;
+}
+
+void usb_hid_clear_report_stats(uint8 instance, uint8 reportID) {
+    HIDReportQueue_t* queue = usb_hid_find_report_queue(hidInterfaces+instance, reportID);
+    if (queue != NULL) {
+        usb_hid_lock();
+        memset(&queue->stats, 0, sizeof(queue->stats));
+        usb_hid_unlock();
+    }
 }
 
-static void hidDataTxCb(void)
+#if MAX_HID_LAST_REPORTS > 0
+/* The lastReports entry of the report ID, or -1. With create, a free entry is
+ * taken for it if it has none, and -1 means the table is full. */
+static int hidFindLastReport(HIDInterface_t* hid, uint8 reportID, uint8 create) {
+    int free = -1;
+
+    for (int i=0; i<MAX_HID_LAST_REPORTS; i++) {
+        if (!hid->lastReports[i].used) {
+            if (free < 0)
+                free = i;
+        }
+        else if (hid->lastReports[i].reportID == reportID) {
+            return i;
+        }
+    }
+    if (!create || free < 0)
+        return -1;
+    hid->lastReports[free].used = 1;
+    hid->lastReports[free].reportID = reportID;
+    hid->lastReports[free].idle = hid->idle;
+    hid->lastReports[free].size = 0;
+    return free;
+}
+#endif
+
+// keeps a report sent through the tx buffer for GET_REPORT(Input)
+static void hidRecordLastReport(HIDInterface_t* hid, uint8 reportID, const uint8* buf, uint32 len) {
+#if MAX_HID_LAST_REPORTS > 0
+    if (len > USB_HID_LAST_REPORT_SIZE)
+        return;
+    usb_hid_lock();
+    int i = hidFindLastReport(hid, reportID, 1);
+    if (i >= 0) {
+        hid->lastReports[i].size = len;
+        memcpy(hid->lastReports[i].data, buf, len);
+    }
+    usb_hid_unlock();
+#else
+    (void)hid; (void)reportID; (void)buf; (void)len;
+#endif
+}
+
+/* This function is non-blocking.
+ *
+ * Queues one whole report, through the report ID's own queue if it has one
+ * and through the tx buffer otherwise. Returns 0 if there is no room yet.
+ * The report is what GET_REPORT(Input) answers with until the next one, if
+ * it has a queue, or if MAX_HID_LAST_REPORTS is set and it fits in
+ * USB_HID_LAST_REPORT_SIZE bytes. */
+uint8 usb_hid_tx_report(uint8 instance, uint8 reportID, const uint8* buf, uint32 len) {
+    HIDInterface_t* hid = hidInterfaces + instance;
+    HIDReportQueue_t* queue = usb_hid_find_report_queue(hid, reportID);
+
+    if (queue == NULL || queue->data == NULL || queue->size != len) {
+        if (usb_hid_tx(instance, buf, len) == 0)
+            return 0;
+        hidRecordLastReport(hid, reportID, buf, len);
+        return 1;
+    }
+
+    usb_hid_lock();
+
+    volatile uint8* newest = REPORT_QUEUE_SLOT(queue, queue->tail + queue->count + queue->depth - 1);
+    volatile uint8* slot;
+
+    uint32 now = usb_generic_micros();
+
+    if (queue->policy == HID_QUEUE_DROP_DUPLICATE && queue->hasLast && 0 == memcmp((uint8*)newest, buf, len) &&
+            (queue->idle == 0 || now - queue->lastQueuedAt < queue->idle * 4000u)) {
+        queue->stats.dropped++;
+        usb_hid_unlock();
+        return 1;
+    }
+
+    if (queue->count < queue->depth) {
+        slot = REPORT_QUEUE_SLOT(queue, queue->tail + queue->count);
+        queue->queuedAt[(queue->tail + queue->count) % queue->depth] = now;
+        queue->count++;
+    }
+    else if (queue->policy == HID_QUEUE_KEEP_LATEST) {
+        // keeps the time of the report it replaces: the host has been waiting since then
+        slot = newest;
+        queue->stats.dropped++;
+    }
+    else {
+        usb_hid_unlock();
+        return 0;
+    }
+
+    memcpy((uint8*)slot, buf, len);
+    queue->hasLast = 1;
+    queue->lastQueuedAt = now;
+
+    if (hid->transmitting<0)
+        hidDataTxCb(hid); // initiate data transmission
+
+    usb_hid_unlock();
+
+    return 1;
+}
+
+/* SET_IDLE: reportID 0 sets the rate of all the reports. Returns 0 for a
+ * report ID whose rate there is nowhere to keep, which is then STALLed. */
+static uint8 hidSetIdle(HIDInterface_t* hid, uint8 reportID, uint8 idle) {
+    uint8 kept = reportID == 0;
+    if (reportID == 0)
+        hid->idle = idle;
+    for (int i=0; i<MAX_HID_REPORT_QUEUES; i++) {
+        if (reportID == 0 || (hid->queues[i].size != 0 && hid->queues[i].reportID == reportID)) {
+            hid->queues[i].idle = idle;
+            kept = 1;
+        }
+    }
+#if MAX_HID_LAST_REPORTS > 0
+    if (reportID == 0) {
+        for (int i=0; i<MAX_HID_LAST_REPORTS; i++)
+            hid->lastReports[i].idle = idle;
+    }
+    else if (!kept) {
+        int i = hidFindLastReport(hid, reportID, 1);
+        if (i >= 0) {
+            hid->lastReports[i].idle = idle;
+            kept = 1;
+        }
+    }
+#endif
+    return kept;
+}
+
+/* The idle rate the host has set for the report, in 4 ms units; 0 means the
+ * report is only to be sent when it changes. */
+uint8 usb_hid_get_idle(uint8 instance, uint8 reportID) {
+    HIDInterface_t* hid = hidInterfaces + instance;
+    if (reportID == 0)
+        return hid->idle;
+    HIDReportQueue_t* queue = usb_hid_find_report_queue(hid, reportID);
+    if (queue != NULL)
+        return queue->idle;
+#if MAX_HID_LAST_REPORTS > 0
+    int i = hidFindLastReport(hid, reportID, 0);
+    if (i >= 0)
+        return hid->lastReports[i].idle;
+#endif
+    return hid->idle;
+}
+
+/* Queues the last report again for each report queue whose idle rate has
+ * passed with nothing new queued, as the host expects of a report with an
+ * idle rate. Call it regularly, e.g., from loop(). */
+void usb_hid_send_idle_reports(uint8 instance) {
+    HIDInterface_t* hid = hidInterfaces + instance;
+    uint8 report[USB_HID_TX_EPSIZE];
+
+    for (int i=0; i<MAX_HID_REPORT_QUEUES; i++) {
+        HIDReportQueue_t* queue = hid->queues + i;
+        usb_hid_lock();
+        uint8 due = queue->data != NULL && queue->hasLast && queue->idle != 0 && queue->count == 0 &&
+            usb_generic_micros() - queue->lastQueuedAt >= queue->idle * 4000u;
+        if (due)
+            memcpy(report, (uint8*)REPORT_QUEUE_SLOT(queue, queue->tail + queue->depth - 1), queue->size);
+        usb_hid_unlock();
+        if (due)
+            usb_hid_tx_report(instance, queue->reportID, report, queue->size);
+    }
+}
+
+/* Number of reports in the report ID's own queue that have not been sent yet. */
+uint8 usb_hid_report_pending(uint8 instance, uint8 reportID) {
+    HIDReportQueue_t* queue = usb_hid_find_report_queue(hidInterfaces+instance, reportID);
+    return queue != NULL ? queue->count : 0;
+}
+
+uint16 usb_hid_get_pending(uint8 instance) {
+    HIDInterface_t* hid = hidInterfaces + instance;
+    return (hid->txHead - hid->txTail) & HID_TX_BUFFER_SIZE_MASK(hid);
+}
+
+/* Starts sending buf as a single report. buf is read while the report is being
+ * sent, so it must not change until usb_hid_stream_busy() returns 0. Returns 0
+ * if a stream report is still being sent. */
+uint8 usb_hid_tx_stream(uint8 instance, const uint8* buf, uint32 len) {
+    HIDInterface_t* hid = hidInterfaces + instance;
+
+    if (len == 0 || hid->bufferTx == NULL)
+        return 1; // not running, nowhere to send it
+
+    usb_hid_lock();
+
+    if (hid->streamLeft || hid->txStreaming) {
+        usb_hid_unlock();
+        return 0;
+    }
+
+    hid->streamData = buf;
+    hid->streamSize = len;
+    hid->streamLeft = len;
+
+    if (hid->transmitting<0)
+        hidDataTxCb(hid); // initiate data transmission
+
+    usb_hid_unlock();
+
+    return 1;
+}
+
+// each one may queue a report; they all get to, so that reporters sharing the interface take turns
+static void hidRunTxIdleCallbacks(HIDInterface_t* hid) {
+    for (unsigned i = 0; i < hid->numTxIdle; i++)
+        hid->txIdle[i].callback(hid->txIdle[i].context);
+}
+
+/* Adds callback, with context, to those called when the interface has
+ * nothing left to send, so that several reporters can share it. Adding it
+ * again does nothing. Returns 0 if there are MAX_HID_TX_IDLE_CALLBACKS
+ * already. */
+uint8 usb_hid_add_tx_idle_callback(uint8 instance, HIDTxIdleCallback callback, void* context) {
+    HIDInterface_t* hid = hidInterfaces + instance;
+    uint8 ok = 1;
+    usb_hid_lock();
+    unsigned i;
+    for (i = 0; i < hid->numTxIdle; i++)
+        if (hid->txIdle[i].callback == callback && hid->txIdle[i].context == context)
+            break;
+    if (i == hid->numTxIdle) {
+        if (i < MAX_HID_TX_IDLE_CALLBACKS) {
+            hid->txIdle[i].callback = callback;
+            hid->txIdle[i].context = context;
+            hid->numTxIdle++;
+        }
+        else {
+            ok = 0;
+        }
+    }
+    usb_hid_unlock();
+    return ok;
+}
+
+void usb_hid_remove_tx_idle_callback(uint8 instance, HIDTxIdleCallback callback, void* context) {
+    HIDInterface_t* hid = hidInterfaces + instance;
+    usb_hid_lock();
+    for (unsigned i = 0; i < hid->numTxIdle; i++) {
+        if (hid->txIdle[i].callback == callback && hid->txIdle[i].context == context) {
+            hid->numTxIdle--;
+            for (; i < hid->numTxIdle; i++)
+                hid->txIdle[i] = hid->txIdle[i+1];
+            break;
+        }
+    }
+    usb_hid_unlock();
+}
+
+void usb_hid_lock(void) {
+    hidLockDepth++; // first, so an interrupt in between cannot turn it back on
+    nvic_irq_disable(NVIC_USB_LP_CAN_RX0);
+}
+
+void usb_hid_unlock(void) {
+    if (--hidLockDepth == 0)
+        nvic_irq_enable(NVIC_USB_LP_CAN_RX0);
+}
+
+/* For when a callback has something new to send: the endpoint will not ask
+ * for it while it is idle. Returns 0 if the interface is not running or has
+ * no callbacks, so that a loop waiting for one to make progress can give up. */
+uint8 usb_hid_run_tx_idle_callback(uint8 instance) {
+    HIDInterface_t* hid = hidInterfaces + instance;
+    if (hid->bufferTx == NULL || hid->numTxIdle == 0)
+        return 0;
+    usb_hid_lock();
+    if (hid->transmitting<0)
+        hidRunTxIdleCallbacks(hid);
+    usb_hid_unlock();
+    return 1;
+}
+
+uint8 usb_hid_stream_busy(uint8 instance) {
+    HIDInterface_t* hid = hidInterfaces + instance;
+    return hid->streamLeft != 0 || hid->txStreaming;
+}
+
+/* Number of stream reports the host has received, wrapping around. */
+uint32 usb_hid_get_stream_completed(uint8 instance) {
+    return hidInterfaces[instance].streamCompleted;
+}
+
+static void hidStartTx(HIDInterface_t* hid, uint16 count) {
+    hid->transmitting = 1;
+    usb_set_ep_tx_count(HID_PART(hid).endpoints[HID_ENDPOINT_TX].address, count);
+    usb_set_ep_tx_stat(HID_PART(hid).endpoints[HID_ENDPOINT_TX].address, USB_EP_STAT_TX_VALID);
+}
+
+#define AGE(n) ((n) < 255 ? (n)+1 : 255)
+
+/* Sends the queued report that is due next, unless the report at the head
+ * of bufferTx (if sharedPending) is. Returns 1 if a queued report was
+ * sent. */
+static uint8 hidSendQueuedReport(HIDInterface_t* hid, uint8 sharedPending) {
+    HIDReportQueue_t* queues = hid->queues;
+    HIDReportQueue_t* best = NULL;
+    uint16 bestPriority = 0;
+
+    for (int i=0; i<MAX_HID_REPORT_QUEUES; i++) {
+        HIDReportQueue_t* queue = queues + (hid->nextQueue + i) % MAX_HID_REPORT_QUEUES;
+        if (queue->size == 0 || queue->count == 0 || queue->data == NULL)
+            continue;
+        uint16 priority = queue->priority + queue->skipped;
+        if (best == NULL || priority > bestPriority) {
+            best = queue;
+            bestPriority = priority;
+        }
+    }
+
+    if (best == NULL || (sharedPending && hid->sharedSkipped > bestPriority)) {
+        // the report in bufferTx goes first
+        for (int i=0; i<MAX_HID_REPORT_QUEUES; i++) {
+            if (queues[i].count != 0)
+                queues[i].skipped = AGE(queues[i].skipped);
+        }
+        hid->sharedSkipped = 0;
+        return 0;
+    }
+
+    for (int i=0; i<MAX_HID_REPORT_QUEUES; i++) {
+        if (queues[i].count != 0 && queues+i != best)
+            queues[i].skipped = AGE(queues[i].skipped);
+    }
+    if (sharedPending)
+        hid->sharedSkipped = AGE(hid->sharedSkipped);
+    best->skipped = 0;
+
+    uint32 latency = usb_generic_micros() - best->queuedAt[best->tail];
+    best->stats.sent++;
+    best->stats.totalLatency += latency;
+    if (latency > best->stats.maxLatency)
+        best->stats.maxLatency = latency;
+
+    usb_copy_to_pma((const uint8*)REPORT_QUEUE_SLOT(best, best->tail), best->size, HID_PART(hid).endpoints[HID_ENDPOINT_TX].pmaAddress);
+    best->tail = (best->tail + 1) % best->depth;
+    best->count--;
+    hid->nextQueue = (best - queues + 1) % MAX_HID_REPORT_QUEUES;
+    hidStartTx(hid, best->size);
+    return 1;
+}
+
+static void hidSendStreamPacket(HIDInterface_t* hid) {
+    uint32 count = hid->streamLeft;
+    if (count > USB_HID_TX_EPSIZE)
+        count = USB_HID_TX_EPSIZE;
+    usb_copy_to_pma(hid->streamData, count, HID_PART(hid).endpoints[HID_ENDPOINT_TX].pmaAddress);
+    hid->streamData += count;
+    hid->streamLeft -= count;
+    hid->txStreaming = 1;
+    if (hid->streamLeft == 0)
+        hid->txZlp = hid->streamSize > USB_HID_TX_EPSIZE && hid->streamSize % USB_HID_TX_EPSIZE == 0;
+    hidStartTx(hid, count);
+}
+
+static void hidDataTxCb(HIDInterface_t* hid)
 {
-	uint32 tail = hid_tx_tail; // load volatile variable
-	uint32 tx_unsent = (hid_tx_head - tail) & HID_TX_BUFFER_SIZE_MASK;
-	if (tx_unsent==0) {
-		if ( (--usbGenericTransmitting)==0) goto flush_hid; // no more data to send
-		return; // it was already flushed, keep Tx endpoint disabled
-	}
-	usbGenericTransmitting = 1;
-    // We can only send up to USBHID_CDCACM_TX_EPSIZE bytes in the endpoint.
-    if (tx_unsent > USB_HID_TX_EPSIZE) {
-        tx_unsent = USB_HID_TX_EPSIZE;
+	uint32 tail = hid->txTail; // load volatile variable
+	uint32 tx_unsent = (hid->txHead - tail) & HID_TX_BUFFER_SIZE_MASK(hid);
+
+	if (hid->txReportLeft == 0) {
+        if (hid->txZlp) {
+            hid->txZlp = 0;
+            hidStartTx(hid, 0);
+            return;
+        }
+        if (hid->streamLeft) {
+            // a stream report keeps the endpoint until it is done
+            hidSendStreamPacket(hid);
+            return;
+        }
+        if (hid->txStreaming) {
+            hid->txStreaming = 0;
+            hid->streamCompleted++;
+        }
+        if (hidSendQueuedReport(hid, tx_unsent != 0))
+            return;
+        if (tx_unsent == 0) {
+            hid->transmitting = -1; // nothing to send, keep Tx endpoint disabled
+            hidRunTxIdleCallbacks(hid); // may start the next report
+            return;
+        }
+        // start the next report in bufferTx
+        hid->txReportLeft = hid->bufferTx[tail];
+        tail = (tail + 1) & HID_TX_BUFFER_SIZE_MASK(hid);
+        hid->txReportLeft |= hid->bufferTx[tail] << 8;
+        tail = (tail + 1) & HID_TX_BUFFER_SIZE_MASK(hid);
+        hid->txZlp = hid->txReportLeft > USB_HID_TX_EPSIZE && hid->txReportLeft % USB_HID_TX_EPSIZE == 0;
+    }
+
+    // We can only send up to USB_HID_TX_EPSIZE bytes in the endpoint.
+    uint32 count = hid->txReportLeft;
+    if (count > USB_HID_TX_EPSIZE) {
+        count = USB_HID_TX_EPSIZE;
     }
 	// copy the bytes from USB Tx buffer to PMA buffer
-	uint32 *dst = usb_pma_ptr(usbHIDPart.endpoints[HID_ENDPOINT_TX].pmaAddress);
+	uint32 *dst = usb_pma_ptr(HID_PART(hid).endpoints[HID_ENDPOINT_TX].pmaAddress);
     uint16 tmp = 0;
 	uint16 val;
 	unsigned i;
-	for (i = 0; i < tx_unsent; i++) {
-		val = hidBufferTx[tail];
-		tail = (tail + 1) & HID_TX_BUFFER_SIZE_MASK;
+	for (i = 0; i < count; i++) {
+		val = hid->bufferTx[tail];
+		tail = (tail + 1) & HID_TX_BUFFER_SIZE_MASK(hid);
 		if (i&1) {
 			*dst++ = tmp | (val<<8);
 		} else {
 			tmp = val;
 		}
 	}
-    if ( tx_unsent&1 ) {
+    if ( count&1 ) {
         *dst = tmp;
     }
-	hid_tx_tail = tail; // store volatile variable
-    
-flush_hid:
-	// enable Tx endpoint
-    usb_set_ep_tx_count(usbHIDPart.endpoints[HID_ENDPOINT_TX].address, tx_unsent);
-    usb_set_ep_tx_stat(usbHIDPart.endpoints[HID_ENDPOINT_TX].address, USB_EP_STAT_TX_VALID);
+	hid->txTail = tail; // store volatile variable
+    hid->txReportLeft -= count;
+
+    hidStartTx(hid, count);
+}
+
+
+
+
+/* Output reports are copied into the output buffers as the packets come in.
+ * A report larger than USB_HID_RX_EPSIZE spans several packets and ends with
+ * a short one (or when the buffer is full). While the buffer a report is for
+ * holds an unread report (and is not HID_BUFFER_MODE_NO_WAIT), the endpoint
+ * NAKs. Reports with no output buffer are dropped. */
+static void hidDataRxCb(HIDInterface_t* hid) {
+    USBEndpointInfo* ep = &HID_PART(hid).endpoints[HID_ENDPOINT_RX];
+    uint32 count = usb_get_ep_rx_count(ep->address);
+    volatile HIDBuffer_t* buffer = hid->rxBuffer;
+
+    hid->rxPending = 0;
+
+    if (buffer == NULL) {
+        // first packet of a report: it starts with the report ID, unless the
+        // descriptor has none or the host has selected the boot protocol
+        if (count > 0 && hid->protocolValue != 0) {
+            uint8 reportID;
+            usb_copy_from_pma(&reportID, 1, ep->pmaAddress);
+            if (reportID != 0)
+                buffer = usb_hid_find_buffer(hid, HID_REPORT_TYPE_OUTPUT, reportID);
+        }
+        if (buffer == NULL)
+            buffer = usb_hid_find_buffer(hid, HID_REPORT_TYPE_OUTPUT, 0);
+        if (buffer != NULL) {
+            if (0 == (buffer->mode & HID_BUFFER_MODE_NO_WAIT) && buffer->state == HID_BUFFER_UNREAD) {
+                hid->rxPending = 1; // keep it in the endpoint, which NAKs meanwhile
+                return;
+            }
+            hidSetBufferState(hid, buffer, HID_BUFFER_EMPTY);
+            hid->rxBuffer = buffer;
+            hid->rxOffset = 0;
+        }
+    }
+
+    if (buffer != NULL) {
+        uint32 n = count;
+        if (n > (uint32)(buffer->bufferSize - hid->rxOffset))
+            n = buffer->bufferSize - hid->rxOffset;
+        usb_copy_from_pma((uint8*)buffer->buffer + hid->rxOffset, n, ep->pmaAddress);
+        hid->rxOffset += n;
+        if (count < USB_HID_RX_EPSIZE || hid->rxOffset >= buffer->bufferSize) {
+            buffer->currentDataSize = hid->rxOffset;
+            hidSetBufferState(hid, buffer, HID_BUFFER_UNREAD);
+            hid->rxBuffer = NULL;
+            hidBufferWritten(hid, buffer);
+        }
+    }
+
+    usb_set_ep_rx_stat(ep->address, USB_EP_STAT_RX_VALID);
 }
 
+/* Takes effect at the next begin(). The host then sends output reports to
+ * the interrupt OUT endpoint instead of with SET_REPORT on the control
+ * endpoint (which still works). */
+void usb_hid_set_out_endpoint(uint8 instance, uint8 enable) {
+    HIDInterface_t* hid = hidInterfaces + instance;
+    hid->outEndpoint = enable != 0;
+    HID_PART(hid).numEndpoints = enable ? 2 : 1;
+    HID_PART(hid).descriptorSize = sizeof(hid_part_config) - (enable ? 0 : sizeof(usb_descriptor_endpoint));
+    usb_generic_invalidate_config();
+}
 
+/* Lets a BIOS find the interface as a boot keyboard (1) or mouse (2). Once it
+ * selects the boot protocol, usb_hid_get_protocol() returns 0 and the reports
+ * have to have the boot layout. Takes effect at the next begin(). */
+void usb_hid_set_interface_protocol(uint8 instance, uint8 protocol) {
+    hidInterfaces[instance].interfaceProtocol = protocol;
+    usb_generic_invalidate_config();
+}
 
-static void hidUSBReset(void) {
+uint8 usb_hid_get_protocol(uint8 instance) {
+    return hidInterfaces[instance].protocolValue;
+}
+
+/* Polling interval in ms (1-255). Takes effect at the next begin(). */
+void usb_hid_set_poll_interval(uint8 instance, uint8 interval) {
+    hidInterfaces[instance].pollInterval = interval ? interval : 1;
+    usb_generic_invalidate_config();
+}
+
+/* Takes effect the next time the part is started. */
+void usb_hid_set_tx_buffer_size(uint8 instance, uint32 size) {
+    HIDInterface_t* hid = hidInterfaces + instance;
+    hid->txBufferSize = usb_generic_ring_size(size, 8);
+    hidUpdateArenaSize(hid);
+}
+
+static void hidResetQueues(HIDInterface_t* hid) {
+	hid->txHead = 0;
+	hid->txTail = 0;
+	hid->txReportLeft = 0;
+	hid->txZlp = 0;
+    for (int i=0; i<MAX_HID_REPORT_QUEUES; i++) {
+        hid->queues[i].tail = 0;
+        hid->queues[i].count = 0;
+        hid->queues[i].hasLast = 0;
+        hid->queues[i].skipped = 0;
+    }
+#if MAX_HID_LAST_REPORTS > 0
+    for (int i=0; i<MAX_HID_LAST_REPORTS; i++)
+        hid->lastReports[i].used = 0;
+#endif
+    hid->sharedSkipped = 0;
+}
+
+static void hidSetArena(HIDInterface_t* hid, void* memory) {
+    volatile uint8* slots = (uint8*)memory + hid->txBufferSize;
+
+    hid->bufferTx = memory;
+    for (int i=0; i<MAX_HID_REPORT_QUEUES; i++) {
+        HIDReportQueue_t* queue = hid->queues+i;
+        if (memory == NULL || queue->size == 0) {
+            queue->data = NULL;
+            queue->queuedAt = NULL;
+        }
+        else {
+            queue->data = slots;
+            queue->queuedAt = (volatile uint32*)(slots + REPORT_QUEUE_DATA_SIZE(queue));
+            slots += REPORT_QUEUE_SIZE(queue);
+        }
+    }
+    hidResetQueues(hid);
+}
+
+// what a saved USBGenericLayout needs besides the part's own fields
+typedef struct {
+    uint8* reportDescriptor;
+    uint32 txBufferSize;
+    uint16 reportDescriptorSize;
+    uint8 outEndpoint;
+    uint8 interfaceProtocol;
+    uint8 pollInterval;
+} HIDPartState;
+
+_Static_assert(sizeof(HIDPartState) <= USB_GENERIC_PART_STATE_SIZE, "HIDPartState does not fit in a layout");
+
+static void hidSaveState(HIDInterface_t* hid, void* state) {
+    HIDPartState* s = (HIDPartState*)state;
+    s->reportDescriptor = hid->reportDescriptor.Descriptor;
+    s->reportDescriptorSize = hid->reportDescriptor.Descriptor_Size;
+    s->outEndpoint = hid->outEndpoint;
+    s->interfaceProtocol = hid->interfaceProtocol;
+    s->pollInterval = hid->pollInterval;
+    s->txBufferSize = hid->txBufferSize;
+}
+
+static void hidLoadState(HIDInterface_t* hid, const void* state) {
+    const HIDPartState* s = (const HIDPartState*)state;
+    hid->reportDescriptor.Descriptor = s->reportDescriptor;
+    hid->reportDescriptor.Descriptor_Size = s->reportDescriptorSize;
+    hid->outEndpoint = s->outEndpoint;
+    hid->interfaceProtocol = s->interfaceProtocol;
+    hid->pollInterval = s->pollInterval;
+    hid->txBufferSize = s->txBufferSize;
+    hidUpdateArenaSize(hid); // the report queues belong to the reporters, which may have changed them
+}
+
+static void hidUSBReset(HIDInterface_t* hid) {
     /* Reset the RX/TX state */
-	hid_tx_head = 0;
-	hid_tx_tail = 0;
+    hidResetQueues(hid);
+    hid->transmitting = -1;
+    hid->rxBuffer = NULL;
+    hid->rxPending = 0;
+    hid->setReportBuffer = NULL;
+    hidControlData = NULL;
+    hid->protocolValue = 1; // devices start in report protocol
+    hidSetIdle(hid, 0, 0);
+    hid->streamLeft = 0;
+    hid->txStreaming = 0;
 
     currentHIDBuffer = NULL;
 }
 
+static void hidStatusIn(HIDInterface_t* hid) {
+    volatile HIDBuffer_t* buffer = hid->setReportBuffer;
+    if (buffer != NULL) {
+        hid->setReportBuffer = NULL;
+        hidBufferWritten(hid, buffer);
+    }
+}
+
 static uint8* HID_Set(uint16 length) {
     if (currentHIDBuffer == NULL)
         return NULL;
@@ -423,7 +1466,7 @@ static uint8* HID_Set(uint16 length) {
         
         currentHIDBuffer->currentDataSize = len;
         
-        currentHIDBuffer->state = HID_BUFFER_EMPTY;
+        hidSetBufferState(hidControl, currentHIDBuffer, HID_BUFFER_EMPTY);
         
         if (pInformation->Ctrl_Info.Usb_wOffset < len) { 
             pInformation->Ctrl_Info.Usb_wLength = len - pInformation->Ctrl_Info.Usb_wOffset;
@@ -435,11 +1478,14 @@ static uint8* HID_Set(uint16 length) {
         return NULL;
     }
     
+    uint8* data = (uint8*)hidControlData + pInformation->Ctrl_Info.Usb_wOffset;
     if (pInformation->USBwLengths.w <= pInformation->Ctrl_Info.Usb_wOffset + pInformation->Ctrl_Info.PacketSize) {
-        currentHIDBuffer->state = HID_BUFFER_UNREAD;
+        hidSetBufferState(hidControl, currentHIDBuffer, HID_BUFFER_UNREAD);
+        hidControl->setReportBuffer = currentHIDBuffer;
+        hidControlData = NULL; // the core copies the last packet before anything else can run
     }
     
-    return (uint8*)currentHIDBuffer->buffer + pInformation->Ctrl_Info.Usb_wOffset;
+    return data;
 }
 
 static uint8* HID_GetFeature(uint16 length) {
@@ -454,20 +1500,24 @@ static uint8* HID_GetFeature(uint16 length) {
         return NULL;
     }
 
-    return (uint8*)currentHIDBuffer->buffer + wOffset;
+    uint8* data = (uint8*)hidControlData + wOffset;
+    if (length >= pInformation->Ctrl_Info.Usb_wLength)
+        hidControlData = NULL; // last packet
+    return data;
 }
 
-static RESULT hidUSBDataSetup(uint8 request) {
+static RESULT hidUSBDataSetup(HIDInterface_t* hid, uint8 request) {
     uint8* (*CopyRoutine)(uint16) = 0;
 	
-	if (pInformation->USBwIndex0 != HID_INTERFACE_NUMBER)
+    hidControlData = NULL; // a new setup ends any transfer the host gave up on
+	if (pInformation->USBwIndex0 != HID_INTERFACE_NUMBER(hid))
 		return USB_UNSUPPORT;
     
     if (Type_Recipient == (CLASS_REQUEST | INTERFACE_RECIPIENT)) {
         switch (request) {
         case SET_REPORT:
 			if (pInformation->USBwValue1 == HID_REPORT_TYPE_FEATURE) {
-				volatile HIDBuffer_t* buffer = usb_hid_find_buffer(HID_REPORT_TYPE_FEATURE, pInformation->USBwValue0);
+				volatile HIDBuffer_t* buffer = usb_hid_find_buffer(hid, HID_REPORT_TYPE_FEATURE, pInformation->USBwValue0);
 				
 				if (buffer == NULL) {
 					return USB_UNSUPPORT;
@@ -479,11 +1529,12 @@ static RESULT hidUSBDataSetup(uint8 request) {
 				else 
 				{
 					currentHIDBuffer = buffer;
+					hidControlData = buffer->buffer;
 					CopyRoutine = HID_Set;        
 				}
 			}
 			else if (pInformation->USBwValue1 == HID_REPORT_TYPE_OUTPUT) {
-				volatile HIDBuffer_t* buffer = usb_hid_find_buffer(HID_REPORT_TYPE_OUTPUT, pInformation->USBwValue0);
+				volatile HIDBuffer_t* buffer = usb_hid_find_buffer(hid, HID_REPORT_TYPE_OUTPUT, pInformation->USBwValue0);
 					
 				if (buffer == NULL) {
 					return USB_UNSUPPORT;
@@ -495,19 +1546,46 @@ static RESULT hidUSBDataSetup(uint8 request) {
 				else 
 				{
 					currentHIDBuffer = buffer;
+					hidControlData = buffer->buffer;
 					CopyRoutine = HID_Set;        
 				}
 			}
             break;
+        case GET_IDLE:
+            hidIdleValue = usb_hid_get_idle(hid - hidInterfaces, pInformation->USBwValue0);
+            CopyRoutine = HID_GetIdle;
+            break;
         case GET_REPORT:
+            if (pInformation->USBwValue1 == HID_REPORT_TYPE_INPUT) {
+                HIDReportQueue_t* queue = usb_hid_find_report_queue(hid, pInformation->USBwValue0);
+                // copied now, as the queue may move on before the host has read it all
+                if (queue != NULL && queue->data != NULL && queue->hasLast) {
+                    hidInputSize = queue->size;
+                    memcpy(hidInput, (uint8*)REPORT_QUEUE_SLOT(queue, queue->tail + queue->count + queue->depth - 1), queue->size);
+                }
+                else {
+#if MAX_HID_LAST_REPORTS > 0
+                    int i = hidFindLastReport(hid, pInformation->USBwValue0, 0);
+                    if (i < 0 || hid->lastReports[i].size == 0)
+                        return USB_UNSUPPORT;
+                    hidInputSize = hid->lastReports[i].size;
+                    memcpy(hidInput, hid->lastReports[i].data, hidInputSize);
+#else
+                    return USB_UNSUPPORT;
+#endif
+                }
+                CopyRoutine = HID_GetInput;
+                break;
+            }
             if (pInformation->USBwValue1 == HID_REPORT_TYPE_FEATURE) {
-				volatile HIDBuffer_t* buffer = usb_hid_find_buffer(HID_REPORT_TYPE_FEATURE, pInformation->USBwValue0);
+				volatile HIDBuffer_t* buffer = usb_hid_find_buffer(hid, HID_REPORT_TYPE_FEATURE, pInformation->USBwValue0);
 				
 				if (buffer == NULL || buffer->state == HID_BUFFER_EMPTY) {
 					return USB_UNSUPPORT;
 				}
 
 				currentHIDBuffer = buffer;
+				hidControlData = buffer->buffer;
 				CopyRoutine = HID_GetFeature;        
 				break;
 			}
@@ -533,14 +1611,16 @@ static RESULT hidUSBDataSetup(uint8 request) {
 		return USB_UNSUPPORT;
 	}
     
+    hidControl = hid;
     pInformation->Ctrl_Info.CopyData = CopyRoutine;
     pInformation->Ctrl_Info.Usb_wOffset = 0;
     (*CopyRoutine)(0);
     return USB_SUCCESS;
 }
 
-static RESULT hidUSBNoDataSetup(uint8 request) {
-	if (pInformation->USBwIndex0 != HID_INTERFACE_NUMBER)
+static RESULT hidUSBNoDataSetup(HIDInterface_t* hid, uint8 request) {
+    hidControlData = NULL;
+	if (pInformation->USBwIndex0 != HID_INTERFACE_NUMBER(hid))
 		return USB_UNSUPPORT;
     
     RESULT ret = USB_UNSUPPORT;
@@ -548,9 +1628,13 @@ static RESULT hidUSBNoDataSetup(uint8 request) {
 	if (Type_Recipient == (CLASS_REQUEST | INTERFACE_RECIPIENT)) {
         switch(request) {
             case SET_PROTOCOL:
-                ProtocolValue = pInformation->USBwValue0;
+                hid->protocolValue = pInformation->USBwValue0;
                 ret = USB_SUCCESS;
                 break;
+            case SET_IDLE:
+                if (hidSetIdle(hid, pInformation->USBwValue0, pInformation->USBwValue1))
+                    ret = USB_SUCCESS;
+                break;
         }
     }
     return ret;
@@ -563,16 +1647,35 @@ static RESULT HID_SetProtocol(void){
 	return USB_SUCCESS;
 }
 */
+static uint8* HID_GetInput(uint16 length) {
+    unsigned wOffset = pInformation->Ctrl_Info.Usb_wOffset;
+
+    if (length == 0) {
+        pInformation->Ctrl_Info.Usb_wLength = hidInputSize - wOffset;
+        return NULL;
+    }
+
+    return hidInput + wOffset;
+}
+
+static uint8* HID_GetIdle(uint16 length) {
+    if (length == 0) {
+        pInformation->Ctrl_Info.Usb_wLength = 1;
+        return NULL;
+    }
+    return &hidIdleValue;
+}
+
 static uint8* HID_GetProtocolValue(uint16 Length){
 	if (Length == 0){
 		pInformation->Ctrl_Info.Usb_wLength = 1;
 		return NULL;
 	} else {
-		return (uint8 *)(&ProtocolValue);
+		return (uint8 *)(&hidControl->protocolValue);
 	}
 }
 
 static uint8* HID_GetReportDescriptor(uint16 Length){
-  return Standard_GetDescriptorData(Length, &HID_Report_Descriptor);
+  return Standard_GetDescriptorData(Length, &hidControl->reportDescriptor);
 }
 
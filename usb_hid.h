@@ -38,18 +38,61 @@
 #include <libmaple/usb.h>
 #include "usb_generic.h"
 
-#define MAX_HID_BUFFERS 8
+/* Feature and output buffers per instance, at most 127. They are found through
+ * a hash table keyed by report type and ID, so control requests take the same
+ * time however many there are. */
+#ifndef MAX_HID_BUFFERS
+#define MAX_HID_BUFFERS 8 // per instance
+#endif
+#define MAX_HID_REPORT_QUEUES 4 // per instance
+#define MAX_HID_TX_IDLE_CALLBACKS 4 // per instance
+/* Report IDs without a queue of their own whose last report GET_REPORT(Input)
+ * can answer with, and whose idle rate SET_IDLE can set, per instance, and the
+ * largest of those reports. Off by default, as the table costs RAM whether it
+ * is used or not; without it, give a report a queue (even of depth 1) for
+ * GET_REPORT(Input) and SET_IDLE to work with it. */
+#ifndef MAX_HID_LAST_REPORTS
+#define MAX_HID_LAST_REPORTS 0
+#endif
+#ifndef USB_HID_LAST_REPORT_SIZE
+#define USB_HID_LAST_REPORT_SIZE 16
+#endif
+
+/* Number of independent HID interfaces (each with its own report descriptor
+ * and endpoint) that can be registered at the same time, at most 4. Each one
+ * costs RAM whether it is used or not, so to have more than one, define it in
+ * the build flags (e.g., -DUSB_HID_MAX_INSTANCES=2), not in the sketch. */
+#ifndef USB_HID_MAX_INSTANCES
+#define USB_HID_MAX_INSTANCES 1
+#endif
 #define HID_BUFFER_SIZE(n,reportID) ((n)+((reportID)!=0))
 #define HID_BUFFER_ALLOCATE_SIZE(n,reportID) ((HID_BUFFER_SIZE((n),(reportID))+1)/2*2)
 
 #define HID_BUFFER_MODE_NO_WAIT 1
 #define HID_BUFFER_MODE_OUTPUT  2
+#define HID_BUFFER_MODE_DEFER_CALLBACK 4 // the callback runs from usb_hid_run_buffer_callbacks()
 
 #define HID_BUFFER_EMPTY    0 
 #define HID_BUFFER_UNREAD   1
 #define HID_BUFFER_READ     2
 
-extern USBCompositePart usbHIDPart;
+#define HID_QUEUE_FIFO           0
+#define HID_QUEUE_KEEP_LATEST    1
+#define HID_QUEUE_DROP_DUPLICATE 2
+
+typedef struct HIDReportStats {
+    uint32 sent;
+    uint32 dropped; // replaced (HID_QUEUE_KEEP_LATEST) or identical (HID_QUEUE_DROP_DUPLICATE)
+    uint32 totalLatency; // microseconds
+    uint32 maxLatency;
+} HIDReportStats;
+
+extern USBCompositePart usbHIDParts[USB_HID_MAX_INSTANCES];
+#define usbHIDPart (usbHIDParts[0])
+
+/* Called when the host has written an output or feature buffer, with the data
+ * after the report ID. See usb_hid_set_buffer_callback(). */
+typedef void (*HIDBufferCallback)(void* context, const uint8* data, uint16 length);
 
 typedef struct HIDBuffer_t {
     volatile uint8_t* buffer; // use HID_BUFFER_ALLOCATE_SIZE() to calculate amount of memory to allocate                            
@@ -58,12 +101,21 @@ typedef struct HIDBuffer_t {
     uint8_t  mode;
     uint16_t currentDataSize;
     uint8_t  state; // HID_BUFFER_EMPTY, etc.
+    volatile uint8_t* backBuffer; // optional, for feature buffers; see usb_hid_set_feature()
+    volatile uint8_t callbackPending; // written, the deferred callback has not run yet
+    HIDBufferCallback callback;
+    void* callbackContext;
 #ifdef __cplusplus
-    inline HIDBuffer_t(volatile uint8_t* _buffer=NULL, uint16_t _bufferSize=0, uint8_t _reportID=0, uint8_t _mode=0) {
+    inline HIDBuffer_t(volatile uint8_t* _buffer=NULL, uint16_t _bufferSize=0, uint8_t _reportID=0, uint8_t _mode=0,
+            volatile uint8_t* _backBuffer=NULL) {
         reportID = _reportID;
         buffer = _buffer;
+        backBuffer = _backBuffer;
         bufferSize = _bufferSize;
         mode = _mode;
+        callbackPending = 0;
+        callback = NULL;
+        callbackContext = NULL;
     }
 #endif
 } HIDBuffer_t;
@@ -73,13 +125,29 @@ extern "C" {
 #endif
 
 #define USB_HID_TX_EPSIZE            	0x40
-
-void usb_hid_set_report_descriptor(const uint8* report_descriptor, uint16 report_descriptor_length);
-void usb_hid_clear_buffers(uint8_t type);
-uint8_t usb_hid_add_buffer(uint8_t type, volatile HIDBuffer_t* buf);
-void usb_hid_set_buffers(uint8_t type, volatile HIDBuffer_t* featureBuffers, int count);    
-uint16_t usb_hid_get_data(uint8_t type, uint8_t reportID, uint8_t* out, uint8_t poll);
-void usb_hid_set_feature(uint8_t reportID, uint8_t* data);
+#define USB_HID_RX_EPSIZE            	0x40
+#define USB_HID_DEFAULT_TX_BUFFER_SIZE  256
+
+/* instance is the index of the HID interface, from 0 to USB_HID_MAX_INSTANCES-1 */
+void usb_hid_set_report_descriptor(uint8 instance, const uint8* report_descriptor, uint16 report_descriptor_length);
+void usb_hid_clear_buffers(uint8 instance, uint8_t type);
+uint8_t usb_hid_add_buffer(uint8 instance, uint8_t type, volatile HIDBuffer_t* buf);
+void usb_hid_set_buffers(uint8 instance, uint8_t type, volatile HIDBuffer_t* featureBuffers, int count);    
+uint16_t usb_hid_get_data(uint8 instance, uint8_t type, uint8_t reportID, uint8_t* out, uint8_t poll);
+uint8 usb_hid_set_feature(uint8 instance, uint8_t reportID, const uint8_t* data);
+uint8 usb_hid_set_buffer_callback(uint8 instance, uint8 type, uint8 reportID, HIDBufferCallback callback, void* context, uint8 deferred);
+void usb_hid_run_buffer_callbacks(uint8 instance);
+void usb_hid_set_tx_buffer_size(uint8 instance, uint32 size);
+void usb_hid_set_poll_interval(uint8 instance, uint8 interval);
+void usb_hid_set_out_endpoint(uint8 instance, uint8 enable);
+void usb_hid_set_interface_protocol(uint8 instance, uint8 protocol);
+uint8 usb_hid_get_protocol(uint8 instance);
+uint8 usb_hid_set_report_queue(uint8 instance, uint8 reportID, uint16 size, uint8 policy, uint8 depth);
+uint8 usb_hid_set_report_priority(uint8 instance, uint8 reportID, uint8 priority);
+uint8 usb_hid_get_report_stats(uint8 instance, uint8 reportID, HIDReportStats* stats);
+void usb_hid_clear_report_stats(uint8 instance, uint8 reportID);
+uint8 usb_hid_get_idle(uint8 instance, uint8 reportID);
+void usb_hid_send_idle_reports(uint8 instance);
 
  
 
@@ -133,17 +201,33 @@ typedef struct
 
 #define USB_INTERFACE_CLASS_HID           0x03
 #define USB_INTERFACE_SUBCLASS_HID		  0x01
+#define HID_INTERFACE_PROTOCOL_KEYBOARD   0x01
+#define HID_INTERFACE_PROTOCOL_MOUSE      0x02
 
  /*
  * HID interface
  */
 
-void   usb_hid_putc(char ch);
-uint32 usb_hid_tx(const uint8* buf, uint32 len);
+void   usb_hid_putc(uint8 instance, char ch);
+uint32 usb_hid_tx(uint8 instance, const uint8* buf, uint32 len);
 uint32 usb_hid_tx_mod(const uint8* buf, uint32 len);
+uint8  usb_hid_tx_report(uint8 instance, uint8 reportID, const uint8* buf, uint32 len);
+uint8  usb_hid_report_pending(uint8 instance, uint8 reportID);
 
 uint32 usb_hid_data_available(void); /* in RX buffer */
-uint16 usb_hid_get_pending(void);
+uint16 usb_hid_get_pending(uint8 instance);
+uint8 usb_hid_tx_stream(uint8 instance, const uint8* buf, uint32 len);
+uint8 usb_hid_stream_busy(uint8 instance);
+uint32 usb_hid_get_stream_completed(uint8 instance);
+/* Called, from the USB interrupt, whenever the interface has nothing left to send */
+typedef void (*HIDTxIdleCallback)(void* context);
+uint8 usb_hid_add_tx_idle_callback(uint8 instance, HIDTxIdleCallback callback, void* context);
+void usb_hid_remove_tx_idle_callback(uint8 instance, HIDTxIdleCallback callback, void* context);
+uint8 usb_hid_run_tx_idle_callback(uint8 instance);
+/* Keep the USB interrupt off between them. They nest, so that code holding the
+ * lock, such as a tx idle callback, can call functions that take it too. */
+void usb_hid_lock(void);
+void usb_hid_unlock(void);
 
 
 #ifdef __cplusplus
@@ -26,6 +26,7 @@ static void usb_mass_clear_feature();
 static RESULT usb_mass_data_setup(uint8 request);
 static RESULT usb_mass_no_data_setup(uint8 request);
 static void usb_mass_reset();
+static void usb_mass_set_arena(void* memory);
 static uint8_t* usb_mass_get_max_lun(uint16_t Length);
 static void usb_mass_in(void);
 static void usb_mass_out(void);
@@ -43,7 +44,7 @@ static uint32_t deviceState = DEVICE_STATE_UNCONNECTED;
 uint8_t usb_mass_botState = BOT_STATE_IDLE;
 BulkOnlyCBW usb_mass_CBW;
 BulkOnlyCSW usb_mass_CSW;
-uint8_t usb_mass_bulkDataBuff[MAX_BULK_PACKET_SIZE];
+uint8_t* usb_mass_bulkDataBuff = NULL; /* MAX_BULK_PACKET_SIZE bytes in the USBComposite arena while running */
 uint16_t usb_mass_dataLength;
 static uint8_t inRequestPending;
 static uint8_t outRequestPending;
@@ -142,9 +143,24 @@ USBCompositePart usbMassPart = {
     .usbNoDataSetup = usb_mass_no_data_setup,
     .usbClearFeature = usb_mass_clear_feature,
     .usbSetConfiguration = usb_mass_set_configuration,
-    .endpoints = usbMassEndpoints
+    .endpoints = usbMassEndpoints,
+    .arenaSize = SCSI_BLOCK_SIZE + MAX_BULK_PACKET_SIZE,
+    .usbSetArena = usb_mass_set_arena
 };
 
+static void usb_mass_set_arena(void* memory) {
+  if (memory == NULL) {
+    SCSI_dataBuffer = NULL;
+    usb_mass_bulkDataBuff = NULL;
+  }
+  else {
+    SCSI_dataBuffer = memory;
+    usb_mass_bulkDataBuff = SCSI_dataBuffer + SCSI_BLOCK_SIZE;
+  }
+  inRequestPending = 0;
+  outRequestPending = 0;
+}
+
 static void usb_mass_reset(void) {
   usb_mass_mal_init(0);
 
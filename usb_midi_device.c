@@ -57,6 +57,7 @@ static void midiDataTxCb(void);
 static void midiDataRxCb(void);
 
 static void usbMIDIReset(void);
+static void usbMIDISetArena(void* memory);
 static RESULT usbMIDIDataSetup(uint8 request);
 static RESULT usbMIDINoDataSetup(uint8 request);
 
@@ -235,14 +236,10 @@ static const usb_descriptor_config usbMIDIDescriptor_Config = {
 
 /* I/O state */
 
-/* Received data */
-static volatile uint32 midiBufferRx[USB_MIDI_RX_EPSIZE/4];
+/* Received data, in the USBComposite arena while the part is running */
+static volatile uint32* midiBufferRx = NULL;
 /* Read index into midiBufferRx */
 static volatile uint32 rx_offset = 0;
-/* Transmit data */
-static volatile uint32 midiBufferTx[USB_MIDI_TX_EPSIZE/4];
-/* Write index into midiBufferTx */
-static volatile uint32 tx_offset = 0;
 /* Number of bytes left to transmit */
 static volatile uint32 n_unsent_packets = 0;
 /* Are we currently sending an IN packet? */
@@ -292,7 +289,9 @@ USBCompositePart usbMIDIPart = {
     .usbReset = usbMIDIReset,
     .usbDataSetup = usbMIDIDataSetup,
     .usbNoDataSetup = usbMIDINoDataSetup,
-    .endpoints = midiEndpoints
+    .endpoints = midiEndpoints,
+    .arenaSize = USB_MIDI_RX_EPSIZE,
+    .usbSetArena = usbMIDISetArena
 };
 
 /*
@@ -414,6 +413,12 @@ static void midiDataRxCb(void) {
 
 }
 
+static void usbMIDISetArena(void* memory) {
+    midiBufferRx = memory;
+    n_unread_packets = 0;
+    rx_offset = 0;
+}
+
 static void usbMIDIReset(void) {
     /* Reset the RX/TX state */
     n_unread_packets = 0;
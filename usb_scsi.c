@@ -43,7 +43,7 @@ uint8_t SCSI_transferState = SCSI_TXFR_IDLE;
 uint32_t SCSI_blockReadCount = 0;
 uint32_t SCSI_blockOffset;
 uint32_t SCSI_counter = 0;
-uint8_t SCSI_dataBuffer[512]; /* 512 bytes (SDCard block size) */
+uint8_t* SCSI_dataBuffer = NULL; /* SCSI_BLOCK_SIZE bytes in the USBComposite arena while running */
 
 uint8_t scsi_address_management(uint8_t lun, uint8_t cmd, uint32_t lba, uint32_t blockNbr);
 void scsi_read_memory(uint8_t lun, uint32_t memoryOffset, uint32_t transferLength);
@@ -73,6 +73,7 @@ extern "C" {
 
   extern uint32_t SCSI_lba;
   extern uint32_t SCSI_blkLen;
+  extern uint8_t* SCSI_dataBuffer;
 
   void scsi_inquiry_cmd(uint8_t lun);
   void scsi_request_sense_cmd(uint8_t lun);
@@ -100,6 +100,8 @@ static void x360DataTxCb(void);
 static void x360DataRxCb(void);
 static void (*x360_rumble_callback)(uint8 left, uint8 right);
 static void (*x360_led_callback)(uint8 pattern);
+static uint8 x360TxInterval = 4;
+static uint8 x360RxInterval = 8;
 
 static void x360Reset(void);
 static RESULT x360DataSetup(uint8 request);
@@ -256,7 +258,7 @@ static const usb_descriptor_config X360Descriptor_Config =
         .bEndpointAddress = (USB_DESCRIPTOR_ENDPOINT_IN | X360_ENDPOINT_TX),//PATCH
         .bmAttributes     = USB_EP_TYPE_INTERRUPT, 
         .wMaxPacketSize   = 0x20, 
-        .bInterval        = 4, 
+        .bInterval        = 4, //PATCH
 	},
 
     .DataOutEndpoint = {
@@ -265,7 +267,7 @@ static const usb_descriptor_config X360Descriptor_Config =
         .bEndpointAddress = (USB_DESCRIPTOR_ENDPOINT_OUT | X360_ENDPOINT_RX),//PATCH
         .bmAttributes     = USB_EP_TYPE_INTERRUPT, 
         .wMaxPacketSize   = 0x20, 
-        .bInterval        = 8, 
+        .bInterval        = 8, //PATCH
     },
 };
 
@@ -292,6 +294,8 @@ static void getX360PartDescriptor(uint8* out) {
     OUT_BYTE(X360Descriptor_Config, HID_Interface.bInterfaceNumber) += usbX360Part.startInterface;
     OUT_BYTE(X360Descriptor_Config, DataOutEndpoint.bEndpointAddress) += usbX360Part.startEndpoint;
     OUT_BYTE(X360Descriptor_Config, DataInEndpoint.bEndpointAddress) += usbX360Part.startEndpoint;
+    OUT_BYTE(X360Descriptor_Config, DataInEndpoint.bInterval) = x360TxInterval;
+    OUT_BYTE(X360Descriptor_Config, DataOutEndpoint.bInterval) = x360RxInterval;
 }
 
 USBCompositePart usbX360Part = {
@@ -335,6 +339,14 @@ void x360_set_led_callback(void (*callback)(uint8 pattern)) {
     x360_led_callback = callback;
 }
 
+/* Polling intervals in ms (1-255) for the IN and OUT endpoints. Takes
+ * effect at the next begin(). */
+void x360_set_poll_intervals(uint8 txInterval, uint8 rxInterval) {
+    x360TxInterval = txInterval ? txInterval : 1;
+    x360RxInterval = rxInterval ? rxInterval : 1;
+    usb_generic_invalidate_config();
+}
+
 /*void x360_disable(void) {
     x360_set_rumble_callback(NULL);
     x360_set_led_callback(NULL);
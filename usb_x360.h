@@ -67,6 +67,7 @@ uint8 x360_is_transmitting(void);
 void x360_set_rx_callback(void (*callback)(const uint8* buffer, uint32 size));
 void x360_set_rumble_callback(void (*callback)(uint8 left, uint8 right));
 void x360_set_led_callback(void (*callback)(uint8 pattern));
+void x360_set_poll_intervals(uint8 txInterval, uint8 rxInterval);
 
 #ifdef __cplusplus
 }